@@ -23,6 +23,13 @@ let package = Package(
                 .target(name: "SwiftIndexStore"),
                 .product(name: "ArgumentParser", package: "swift-argument-parser"),
             ]),
+        .executableTarget(
+            name: "IndexStoreBenchmarks",
+            dependencies: [
+                .target(name: "SwiftIndexStore"),
+                .target(name: "_CBenchmarkSupport"),
+                .product(name: "ArgumentParser", package: "swift-argument-parser"),
+            ]),
         .target(
             name: "SwiftIndexStore",
             dependencies: [
@@ -31,6 +38,9 @@ let package = Package(
         .target(
             name: "_CIndexStore",
             dependencies: []),
+        .target(
+            name: "_CBenchmarkSupport",
+            dependencies: []),
         .testTarget(
             name: "SwiftIndexStoreTests",
             dependencies: ["SwiftIndexStore"]),
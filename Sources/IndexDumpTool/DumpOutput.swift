@@ -0,0 +1,621 @@
+import SwiftIndexStore
+import Foundation
+import ArgumentParser
+
+enum OutputFormat: String, ExpressibleByArgument, CaseIterable {
+    case text
+    case jsonl
+    case binary
+
+    func makeEncoder() -> DumpEncoder {
+        switch self {
+        case .text: return TextEncoder()
+        case .jsonl: return JSONLinesEncoder()
+        case .binary: return BinaryEncoder()
+        }
+    }
+}
+
+struct DumpOptions: ParsableArguments {
+
+    @Option(help: "Output format: text, jsonl or binary")
+    var format: OutputFormat = .text
+
+    @Option(help: "Number of units dumped in parallel; output order doesn't depend on it")
+    var jobs: Int = IndexStore.defaultWorkerCount
+
+    @Option(help: "Only dump units of this module; can be repeated")
+    var module: [String] = []
+
+    @Option(help: "Only dump dependencies and records whose file path matches this glob")
+    var pathGlob: String?
+
+    @Flag(help: "Skip system units, dependencies and records")
+    var nonSystemOnly: Bool = false
+
+    func units(of indexStore: IndexStore) -> [IndexStoreUnit] {
+        indexStore.units(includeSystem: !nonSystemOnly)
+    }
+
+    func includes(_ unit: IndexStoreUnit, in indexStore: IndexStore) throws -> Bool {
+        guard !module.isEmpty else { return true }
+        guard let moduleName = try indexStore.moduleName(for: unit) else { return false }
+        return module.contains(moduleName)
+    }
+
+    func includes(path: String?, isSystem: Bool) -> Bool {
+        if nonSystemOnly, isSystem {
+            return false
+        }
+        if let pathGlob {
+            guard let path, fnmatch(pathGlob, path, 0) == 0 else { return false }
+        }
+        return true
+    }
+}
+
+/// Encodes every item on `jobs` threads and writes the results to standard
+/// output in item order.
+///
+/// Items are processed in windows of a few items per job, so memory stays
+/// bounded by the window no matter how large the store is.
+func writeOrdered<Item>(_ items: [Item], jobs: Int, _ encode: (Item) throws -> [UInt8]) throws {
+    let jobs = max(1, jobs)
+    let windowSize = jobs * 4
+    var start = 0
+    while start < items.count {
+        let window = items[start..<min(items.count, start + windowSize)]
+        var chunks = [[UInt8]](repeating: [], count: window.count)
+        if jobs == 1 {
+            for (offset, item) in window.enumerated() {
+                chunks[offset] = try encode(item)
+            }
+        } else {
+            let lock = NSLock()
+            var next = 0
+            var firstError: Error?
+            chunks.withUnsafeMutableBufferPointer { chunks in
+                DispatchQueue.concurrentPerform(iterations: min(jobs, window.count)) { _ in
+                    while true {
+                        lock.lock()
+                        let offset = firstError == nil ? next : window.count
+                        next += 1
+                        lock.unlock()
+                        guard offset < window.count else { return }
+                        do {
+                            chunks[offset] = try encode(window[window.startIndex + offset])
+                        } catch {
+                            lock.lock()
+                            firstError = firstError ?? error
+                            lock.unlock()
+                        }
+                    }
+                }
+            }
+            if let firstError {
+                throw firstError
+            }
+        }
+        for chunk in chunks {
+            writeToStandardOutput(chunk)
+        }
+        start += window.count
+    }
+    fflush(stdout)
+}
+
+func writeToStandardOutput(_ bytes: [UInt8]) {
+    guard !bytes.isEmpty else { return }
+    bytes.withUnsafeBufferPointer {
+        _ = fwrite($0.baseAddress, 1, $0.count, stdout)
+    }
+}
+
+/// A growable byte buffer with the primitive encodings of the dump formats.
+struct OutputBuffer {
+    private static let hexDigits = Array("0123456789abcdef".utf8)
+
+    private(set) var bytes: [UInt8] = []
+
+    mutating func write(_ string: String) {
+        bytes.append(contentsOf: string.utf8)
+    }
+
+    mutating func write(_ ref: IndexStoreStringRef) {
+        ref.withUnsafeBytes { bytes.append(contentsOf: $0) }
+    }
+
+    mutating func write(bytes other: [UInt8]) {
+        bytes.append(contentsOf: other)
+    }
+
+    mutating func write(byte: UInt8) {
+        bytes.append(byte)
+    }
+
+    mutating func write(decimal value: Int64) {
+        if value < 0 {
+            bytes.append(UInt8(ascii: "-"))
+        }
+        var magnitude = value.magnitude
+        var digitCount = 1
+        var rest = magnitude / 10
+        while rest > 0 {
+            digitCount += 1
+            rest /= 10
+        }
+        bytes.append(contentsOf: repeatElement(UInt8(ascii: "0"), count: digitCount))
+        var index = bytes.count - 1
+        repeat {
+            bytes[index] = UInt8(ascii: "0") + UInt8(magnitude % 10)
+            magnitude /= 10
+            index -= 1
+        } while magnitude > 0
+    }
+
+    /// Writes a JSON string literal, or `null`.
+    mutating func write(json string: String?) {
+        guard var string else {
+            write("null")
+            return
+        }
+        string.withUTF8 { write(jsonBytes: UnsafeRawBufferPointer($0)) }
+    }
+
+    /// Writes a JSON string literal, or `null` for a null ref.
+    mutating func write(json ref: IndexStoreStringRef) {
+        guard !ref.isNull else {
+            write("null")
+            return
+        }
+        ref.withUnsafeBytes { write(jsonBytes: $0) }
+    }
+
+    private mutating func write(jsonBytes raw: UnsafeRawBufferPointer) {
+        bytes.append(UInt8(ascii: "\""))
+        for byte in raw {
+            switch byte {
+            case UInt8(ascii: "\""), UInt8(ascii: "\\"):
+                bytes.append(UInt8(ascii: "\\"))
+                bytes.append(byte)
+            case UInt8(ascii: "\n"):
+                write("\\n")
+            case UInt8(ascii: "\r"):
+                write("\\r")
+            case UInt8(ascii: "\t"):
+                write("\\t")
+            case 0..<0x20:
+                write("\\u00")
+                bytes.append(Self.hexDigits[Int(byte >> 4)])
+                bytes.append(Self.hexDigits[Int(byte & 0xf)])
+            default:
+                bytes.append(byte)
+            }
+        }
+        bytes.append(UInt8(ascii: "\""))
+    }
+
+    /// Writes `value` in unsigned LEB128.
+    mutating func write(varint value: UInt64) {
+        var value = value
+        while value >= 0x80 {
+            bytes.append(UInt8(truncatingIfNeeded: value) | 0x80)
+            value >>= 7
+        }
+        bytes.append(UInt8(value))
+    }
+
+    mutating func write(bytesOf ref: IndexStoreStringRef) {
+        ref.withUnsafeBytes {
+            write(varint: UInt64($0.count))
+            bytes.append(contentsOf: $0)
+        }
+    }
+
+    mutating func write(bytesOf string: String) {
+        write(varint: UInt64(string.utf8.count))
+        bytes.append(contentsOf: string.utf8)
+    }
+}
+
+/// Turns dump events into bytes of one output format.
+///
+/// An encoder is used for a single chunk of output, a unit or a distinct
+/// record, so chunks can be encoded in parallel.
+protocol DumpEncoder {
+    /// Starts a unit of `print-unit`.
+    mutating func unit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer)
+    mutating func unitDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer)
+    /// Starts a unit of `print-record`.
+    mutating func recordsOfUnit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer)
+    mutating func recordDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer)
+    mutating func distinctRecord(_ entry: IndexStoreRecordOwnership.Entry, into buffer: inout OutputBuffer)
+    mutating func beginSymbols(into buffer: inout OutputBuffer)
+    mutating func symbol(_ symbol: IndexStoreSymbolRef, into buffer: inout OutputBuffer)
+    mutating func beginOccurrences(into buffer: inout OutputBuffer)
+    mutating func occurrence(_ occurrence: IndexStoreOccurrenceRef, into buffer: inout OutputBuffer)
+    mutating func summary(_ ownership: IndexStoreRecordOwnership, into buffer: inout OutputBuffer)
+}
+
+extension DumpEncoder {
+    mutating func beginSymbols(into buffer: inout OutputBuffer) {}
+    mutating func beginOccurrences(into buffer: inout OutputBuffer) {}
+}
+
+/// Memoizes the descriptions of small enum-like values.
+struct DescriptionCache<Key: Hashable> {
+    private var descriptions: [Key: String] = [:]
+    private let describe: (Key) -> String
+
+    init(_ describe: @escaping (Key) -> String) {
+        self.describe = describe
+    }
+
+    mutating func callAsFunction(_ key: Key) -> String {
+        if let description = descriptions[key] {
+            return description
+        }
+        let description = describe(key)
+        descriptions[key] = description
+        return description
+    }
+}
+
+/// The historical human-readable format.
+struct TextEncoder: DumpEncoder {
+    private var kinds = DescriptionCache<IndexStoreSymbol.Kind> { "\($0)" }
+    private var subKinds = DescriptionCache<IndexStoreSymbol.SubKind> { "\($0)" }
+    private var languages = DescriptionCache<IndexStoreSymbol.Language> { "\($0)" }
+    private var roles = DescriptionCache<IndexStoreOccurrence.Role> { "\($0)" }
+    private var recordPath: String?
+
+    mutating func unit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        buffer.write("------------------------------\nUnit: \"\(unit.name ?? "")\"\nDependencies:\n")
+    }
+
+    mutating func unitDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        let typeName: String
+        switch dependency {
+        case .record: typeName = "Record"
+        case .unit: typeName = "Unit"
+        case .file: typeName = "File"
+        }
+        buffer.write("""
+        - \(typeName) |
+          name = \(dependency.name ?? "")
+          filePath = \(dependency.filePath ?? "")
+          isSystem = \(dependency.isSystem)
+
+        """)
+    }
+
+    mutating func recordsOfUnit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        buffer.write("=============================\nUnit: \"\(unit.name ?? "")\"\n")
+    }
+
+    mutating func recordDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        recordPath = dependency.filePath
+        buffer.write("------------------------------\nRecord: \"\(dependency.filePath ?? "")\"\n")
+    }
+
+    mutating func distinctRecord(_ entry: IndexStoreRecordOwnership.Entry, into buffer: inout OutputBuffer) {
+        recordPath = entry.record.filePath
+        buffer.write("""
+        =============================
+        Record: "\(entry.record.filePath ?? "")"
+        Units: \(entry.units.map { $0.name ?? "" }.joined(separator: ", "))
+
+        """)
+    }
+
+    mutating func beginSymbols(into buffer: inout OutputBuffer) {
+        buffer.write("----------Symbols----------\n")
+    }
+
+    mutating func symbol(_ symbol: IndexStoreSymbolRef, into buffer: inout OutputBuffer) {
+        buffer.write("| usr = ")
+        buffer.write(symbol.usr)
+        buffer.write(" | name = ")
+        buffer.write(symbol.name)
+        buffer.write(" | kind = ")
+        buffer.write(kinds(symbol.kind))
+        buffer.write(" | subKind = ")
+        buffer.write(subKinds(symbol.subKind))
+        buffer.write(" | language = ")
+        buffer.write(languages(symbol.language))
+        buffer.write(" |\n")
+    }
+
+    mutating func beginOccurrences(into buffer: inout OutputBuffer) {
+        buffer.write("----------Occurrences----------\n")
+    }
+
+    mutating func occurrence(_ occurrence: IndexStoreOccurrenceRef, into buffer: inout OutputBuffer) {
+        let location = occurrence.lineAndColumn
+        buffer.write("| roles = ")
+        buffer.write(roles(occurrence.roles))
+        buffer.write(" | usr = ")
+        buffer.write(occurrence.symbol.usr)
+        buffer.write(" | location = ")
+        buffer.write(recordPath ?? "")
+        buffer.write(byte: UInt8(ascii: ":"))
+        buffer.write(decimal: location.line)
+        buffer.write(byte: UInt8(ascii: ":"))
+        buffer.write(decimal: location.column)
+        buffer.write(" |\n")
+    }
+
+    mutating func summary(_ ownership: IndexStoreRecordOwnership, into buffer: inout OutputBuffer) {
+        buffer.write("""
+        =============================
+        Record dependencies: \(ownership.dependencyCount)
+        Distinct records: \(ownership.distinctRecordCount)
+        Dedup ratio: \(String(format: "%.2f", ownership.dedupRatio))
+
+        """)
+    }
+}
+
+/// One JSON object per line, each with a `type` field: `unit`, `dependency`,
+/// `record`, `symbol`, `occurrence` or `summary`.
+struct JSONLinesEncoder: DumpEncoder {
+    private var kinds = DescriptionCache<IndexStoreSymbol.Kind> { "\"\($0)\"" }
+    private var subKinds = DescriptionCache<IndexStoreSymbol.SubKind> { "\"\($0)\"" }
+    private var languages = DescriptionCache<IndexStoreSymbol.Language> { "\"\($0)\"" }
+    private var roles = DescriptionCache<IndexStoreOccurrence.Role> { roles in
+        "[" + roles.names.map { "\"\($0)\"" }.joined(separator: ",") + "]"
+    }
+    /// The encoded fields identifying the current unit or record, shared by
+    /// the lines nested in it.
+    private var unitField: [UInt8] = []
+    private var recordFields: [UInt8] = []
+
+    mutating func unit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        var field = OutputBuffer()
+        field.write("\"unit\":")
+        field.write(json: unit.name)
+        unitField = field.bytes
+        buffer.write("{\"type\":\"unit\",\"name\":")
+        buffer.write(json: unit.name)
+        buffer.write("}\n")
+    }
+
+    mutating func unitDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        let kind: String
+        switch dependency {
+        case .record: kind = "record"
+        case .unit: kind = "unit"
+        case .file: kind = "file"
+        }
+        buffer.write("{\"type\":\"dependency\",")
+        buffer.write(bytes: unitField)
+        buffer.write(",\"kind\":\"\(kind)\",\"name\":")
+        buffer.write(json: dependency.name)
+        buffer.write(",\"filePath\":")
+        buffer.write(json: dependency.filePath)
+        buffer.write(",\"isSystem\":\(dependency.isSystem)}\n")
+    }
+
+    mutating func recordsOfUnit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        self.unit(unit, into: &buffer)
+    }
+
+    mutating func recordDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        guard case .record(let record) = dependency else { return }
+        startRecord(record)
+        buffer.write("{\"type\":\"record\",")
+        buffer.write(bytes: unitField)
+        buffer.write(",")
+        buffer.write(bytes: recordFields)
+        buffer.write(",\"isSystem\":\(record.isSystem)}\n")
+    }
+
+    mutating func distinctRecord(_ entry: IndexStoreRecordOwnership.Entry, into buffer: inout OutputBuffer) {
+        startRecord(entry.record)
+        buffer.write("{\"type\":\"record\",\"units\":[")
+        for (index, unit) in entry.units.enumerated() {
+            if index > 0 {
+                buffer.write(",")
+            }
+            buffer.write(json: unit.name)
+        }
+        buffer.write("],")
+        buffer.write(bytes: recordFields)
+        buffer.write(",\"isSystem\":\(entry.record.isSystem)}\n")
+    }
+
+    mutating func symbol(_ symbol: IndexStoreSymbolRef, into buffer: inout OutputBuffer) {
+        buffer.write("{\"type\":\"symbol\",")
+        buffer.write(bytes: recordFields)
+        buffer.write(",\"usr\":")
+        buffer.write(json: symbol.usr)
+        buffer.write(",\"name\":")
+        buffer.write(json: symbol.name)
+        buffer.write(",\"kind\":")
+        buffer.write(kinds(symbol.kind))
+        buffer.write(",\"subKind\":")
+        buffer.write(subKinds(symbol.subKind))
+        buffer.write(",\"language\":")
+        buffer.write(languages(symbol.language))
+        buffer.write("}\n")
+    }
+
+    mutating func occurrence(_ occurrence: IndexStoreOccurrenceRef, into buffer: inout OutputBuffer) {
+        let location = occurrence.lineAndColumn
+        buffer.write("{\"type\":\"occurrence\",")
+        buffer.write(bytes: recordFields)
+        buffer.write(",\"usr\":")
+        buffer.write(json: occurrence.symbol.usr)
+        buffer.write(",\"roles\":")
+        buffer.write(roles(occurrence.roles))
+        buffer.write(",\"line\":")
+        buffer.write(decimal: location.line)
+        buffer.write(",\"column\":")
+        buffer.write(decimal: location.column)
+        buffer.write("}\n")
+    }
+
+    mutating func summary(_ ownership: IndexStoreRecordOwnership, into buffer: inout OutputBuffer) {
+        buffer.write("""
+        {"type":"summary","recordDependencies":\(ownership.dependencyCount),\
+        "distinctRecords":\(ownership.distinctRecordCount),\
+        "dedupRatio":\(String(format: "%.4f", ownership.dedupRatio))}
+
+        """)
+    }
+
+    private mutating func startRecord(_ record: IndexStoreUnit.Dependency.Record) {
+        var fields = OutputBuffer()
+        fields.write("\"record\":")
+        fields.write(json: record.name)
+        fields.write(",\"filePath\":")
+        fields.write(json: record.filePath)
+        recordFields = fields.bytes
+    }
+}
+
+/// A compact binary stream.
+///
+/// The stream starts with the magic `SIXD` and a format version, then holds
+/// entries made of a tag byte and its fields. Integers are unsigned LEB128
+/// varints and booleans single bytes. A string is a varint `n`: 0 is a null
+/// string, 1 introduces a new string as a byte length and UTF-8 bytes, and
+/// `n >= 2` refers to the `n - 2`th string introduced so far. The string
+/// table is reset at each `unit` and `distinctRecord` entry, which start the
+/// independently encoded chunks of the stream.
+///
+/// | Tag | Entry          | Fields                                                  |
+/// |-----|----------------|---------------------------------------------------------|
+/// | 1   | unit           | name                                                    |
+/// | 2   | dependency     | kind (0 record, 1 unit, 2 file), name, filePath, isSystem |
+/// | 3   | record         | name, filePath, isSystem                                |
+/// | 4   | distinctRecord | name, filePath, isSystem, unit count, unit names        |
+/// | 5   | symbol         | usr, name, kind, subKind, language                      |
+/// | 6   | occurrence     | usr, roles, line, column                                |
+/// | 7   | summary        | record dependency count, distinct record count          |
+struct BinaryEncoder: DumpEncoder {
+    static let magic = "SIXD"
+    static let version: UInt64 = 1
+
+    private enum Tag: UInt8 {
+        case unit = 1
+        case dependency
+        case record
+        case distinctRecord
+        case symbol
+        case occurrence
+        case summary
+    }
+
+    private var strings = IndexStoreStringInterner(shardCount: 1)
+    private var stringIndices: [IndexStoreStringInterner.ID: UInt64] = [:]
+
+    static func writeHeader() {
+        var buffer = OutputBuffer()
+        buffer.write(magic)
+        buffer.write(varint: version)
+        writeToStandardOutput(buffer.bytes)
+    }
+
+    mutating func unit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        resetStrings()
+        buffer.write(byte: Tag.unit.rawValue)
+        write(string: unit.name, into: &buffer)
+    }
+
+    mutating func unitDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        buffer.write(byte: Tag.dependency.rawValue)
+        switch dependency {
+        case .record: buffer.write(varint: 0)
+        case .unit: buffer.write(varint: 1)
+        case .file: buffer.write(varint: 2)
+        }
+        write(string: dependency.name, into: &buffer)
+        write(string: dependency.filePath, into: &buffer)
+        buffer.write(byte: dependency.isSystem ? 1 : 0)
+    }
+
+    mutating func recordsOfUnit(_ unit: IndexStoreUnit, into buffer: inout OutputBuffer) {
+        self.unit(unit, into: &buffer)
+    }
+
+    mutating func recordDependency(_ dependency: IndexStoreUnit.Dependency, into buffer: inout OutputBuffer) {
+        guard case .record(let record) = dependency else { return }
+        buffer.write(byte: Tag.record.rawValue)
+        write(string: record.name, into: &buffer)
+        write(string: record.filePath, into: &buffer)
+        buffer.write(byte: record.isSystem ? 1 : 0)
+    }
+
+    mutating func distinctRecord(_ entry: IndexStoreRecordOwnership.Entry, into buffer: inout OutputBuffer) {
+        resetStrings()
+        buffer.write(byte: Tag.distinctRecord.rawValue)
+        write(string: entry.record.name, into: &buffer)
+        write(string: entry.record.filePath, into: &buffer)
+        buffer.write(byte: entry.record.isSystem ? 1 : 0)
+        buffer.write(varint: UInt64(entry.units.count))
+        for unit in entry.units {
+            write(string: unit.name, into: &buffer)
+        }
+    }
+
+    mutating func symbol(_ symbol: IndexStoreSymbolRef, into buffer: inout OutputBuffer) {
+        buffer.write(byte: Tag.symbol.rawValue)
+        write(string: symbol.usr, into: &buffer)
+        write(string: symbol.name, into: &buffer)
+        buffer.write(varint: UInt64(symbol.kind.rawValue))
+        buffer.write(varint: UInt64(symbol.subKind.rawValue))
+        buffer.write(varint: UInt64(symbol.language.rawValue))
+    }
+
+    mutating func occurrence(_ occurrence: IndexStoreOccurrenceRef, into buffer: inout OutputBuffer) {
+        let location = occurrence.lineAndColumn
+        buffer.write(byte: Tag.occurrence.rawValue)
+        write(string: occurrence.symbol.usr, into: &buffer)
+        buffer.write(varint: occurrence.roles.rawValue)
+        buffer.write(varint: UInt64(clamping: location.line))
+        buffer.write(varint: UInt64(clamping: location.column))
+    }
+
+    mutating func summary(_ ownership: IndexStoreRecordOwnership, into buffer: inout OutputBuffer) {
+        buffer.write(byte: Tag.summary.rawValue)
+        buffer.write(varint: UInt64(ownership.dependencyCount))
+        buffer.write(varint: UInt64(ownership.distinctRecordCount))
+    }
+
+    private mutating func resetStrings() {
+        guard !stringIndices.isEmpty else { return }
+        strings = IndexStoreStringInterner(shardCount: 1)
+        stringIndices.removeAll(keepingCapacity: true)
+    }
+
+    private mutating func write(string: IndexStoreStringRef, into buffer: inout OutputBuffer) {
+        guard !string.isNull else {
+            buffer.write(varint: 0)
+            return
+        }
+        let id = strings.intern(string)
+        if let index = stringIndices[id] {
+            buffer.write(varint: index + 2)
+            return
+        }
+        stringIndices[id] = UInt64(stringIndices.count)
+        buffer.write(varint: 1)
+        buffer.write(bytesOf: string)
+    }
+
+    private mutating func write(string: String?, into buffer: inout OutputBuffer) {
+        guard let string else {
+            buffer.write(varint: 0)
+            return
+        }
+        let id = strings.intern(string)
+        if let index = stringIndices[id] {
+            buffer.write(varint: index + 2)
+            return
+        }
+        stringIndices[id] = UInt64(stringIndices.count)
+        buffer.write(varint: 1)
+        buffer.write(bytesOf: string)
+    }
+}
@@ -8,13 +8,24 @@ struct IndexDumpTool: ParsableCommand {
         @Option(transform: URL.init(fileURLWithPath: ))
         var indexStorePath: URL
 
+        @Flag(help: "Print libIndexStore call counts, scan timings and reader cache statistics to standard error")
+        var stats: Bool = false
+
         func getIndexStore() throws -> IndexStore {
-            try IndexStore.open(store: indexStorePath, lib: .open())
+            if stats {
+                IndexStoreInstrumentation.start()
+            }
+            return try IndexStore.open(store: indexStorePath, lib: .shared)
+        }
+
+        func printStatistics(of indexStore: IndexStore) {
+            guard stats, let snapshot = IndexStoreInstrumentation.stop(store: indexStore) else { return }
+            FileHandle.standardError.write(Data("\(snapshot)\n".utf8))
         }
     }
 
     static var configuration = CommandConfiguration(subcommands: [
-        PrintUnit.self, PrintRecord.self
+        PrintUnit.self, PrintRecord.self, UnusedDeclarations.self, Occurrences.self, Serve.self, Query.self
     ])
 }
 
@@ -23,31 +34,28 @@ struct PrintUnit: ParsableCommand {
     @OptionGroup()
     var options: IndexDumpTool.Options
 
+    @OptionGroup()
+    var dump: DumpOptions
+
     func run() throws {
         let indexStore = try options.getIndexStore()
-        try indexStore.forEachUnits { unit -> Bool in
-            print("""
-------------------------------
-Unit: \"\(unit.name ?? "")\"
-Dependencies:
-""")
+        defer { options.printStatistics(of: indexStore) }
+        if dump.format == .binary {
+            BinaryEncoder.writeHeader()
+        }
+        try writeOrdered(dump.units(of: indexStore), jobs: dump.jobs) { unit in
+            guard try dump.includes(unit, in: indexStore) else { return [] }
+            var encoder = dump.format.makeEncoder()
+            var buffer = OutputBuffer()
+            var hasDependencies = false
+            encoder.unit(unit, into: &buffer)
             try indexStore.forEachRecordDependencies(for: unit) { dependency -> Bool in
-                let typeName: String = {
-                    switch dependency {
-                    case .record: return "Record"
-                    case .unit: return "Unit"
-                    case .file: return "File"
-                    }
-                }()
-                print("- \(typeName) |")
-                print("""
-  name = \(dependency.name ?? "")
-  filePath = \(dependency.filePath ?? "")
-  isSystem = \(dependency.isSystem)
-""")
+                guard dump.includes(path: dependency.filePath, isSystem: dependency.isSystem) else { return true }
+                hasDependencies = true
+                encoder.unitDependency(dependency, into: &buffer)
                 return true
             }
-            return true
+            return hasDependencies || dump.pathGlob == nil ? buffer.bytes : []
         }
     }
 }
@@ -57,36 +65,254 @@ struct PrintRecord: ParsableCommand {
     @OptionGroup()
     var options: IndexDumpTool.Options
 
+    @OptionGroup()
+    var dump: DumpOptions
+
+    @Flag(help: "Print each distinct record once with the units that depend on it")
+    var distinctRecords: Bool = false
+
     func run() throws {
         let indexStore = try options.getIndexStore()
-        try indexStore.forEachUnits { unit -> Bool in
-            print("""
-=============================
-Unit: \"\(unit.name ?? "")\"
-""")
+        defer { options.printStatistics(of: indexStore) }
+        if dump.format == .binary {
+            BinaryEncoder.writeHeader()
+        }
+        if distinctRecords {
+            try printDistinctRecords(indexStore: indexStore)
+            return
+        }
+        try writeOrdered(dump.units(of: indexStore), jobs: dump.jobs) { unit in
+            guard try dump.includes(unit, in: indexStore) else { return [] }
+            var encoder = dump.format.makeEncoder()
+            var buffer = OutputBuffer()
+            var hasRecords = false
+            encoder.recordsOfUnit(unit, into: &buffer)
             try indexStore.forEachRecordDependencies(for: unit) { dependency -> Bool in
-                print("""
-------------------------------
-Record: \"\(dependency.filePath ?? "")\"
-""")
+                guard dump.includes(path: dependency.filePath, isSystem: dependency.isSystem) else { return true }
+                encoder.recordDependency(dependency, into: &buffer)
                 guard case let .record(record) = dependency else { return true }
-                try dumpRecord(record, indexStore: indexStore)
+                hasRecords = true
+                try dumpRecord(record, indexStore: indexStore, encoder: &encoder, into: &buffer)
                 return true
             }
-            return true
+            return hasRecords || dump.pathGlob == nil ? buffer.bytes : []
+        }
+    }
+
+    private func printDistinctRecords(indexStore: IndexStore) throws {
+        let ownership = try indexStore.recordOwnership(includeSystem: !dump.nonSystemOnly, workerCount: dump.jobs)
+        try writeOrdered(ownership.records, jobs: dump.jobs) { entry in
+            guard dump.includes(path: entry.record.filePath, isSystem: entry.record.isSystem) else { return [] }
+            if !dump.module.isEmpty {
+                let modules = try entry.units.compactMap { try indexStore.moduleName(for: $0) }
+                guard modules.contains(where: { dump.module.contains($0) }) else { return [] }
+            }
+            var encoder = dump.format.makeEncoder()
+            var buffer = OutputBuffer()
+            encoder.distinctRecord(entry, into: &buffer)
+            try dumpRecord(entry.record, indexStore: indexStore, encoder: &encoder, into: &buffer)
+            return buffer.bytes
+        }
+        var encoder = dump.format.makeEncoder()
+        var buffer = OutputBuffer()
+        encoder.summary(ownership, into: &buffer)
+        writeToStandardOutput(buffer.bytes)
+        fflush(stdout)
+    }
+}
+
+struct UnusedDeclarations: ParsableCommand {
+
+    static var configuration = CommandConfiguration(
+        abstract: "Print the declarations nothing in the store references"
+    )
+
+    @OptionGroup()
+    var options: IndexDumpTool.Options
+
+    @Flag(help: "Scan system records and report their declarations too")
+    var includeSystem: Bool = false
+
+    @Flag(help: "Don't count references synthesized by the compiler")
+    var ignoreImplicitReferences: Bool = false
+
+    func run() throws {
+        let indexStore = try options.getIndexStore()
+        defer { options.printStatistics(of: indexStore) }
+        let unused = try indexStore.unusedDeclarations(options: .init(
+            countsImplicitReferences: !ignoreImplicitReferences,
+            includeSystem: includeSystem
+        ))
+        for declaration in unused {
+            print("\(declaration.path ?? ""):\(declaration.line):\(declaration.column): \(declaration.kind) \(declaration.name) | usr = \(declaration.usr)")
+        }
+    }
+}
+
+struct Occurrences: ParsableCommand {
+
+    static var configuration = CommandConfiguration(
+        abstract: "Print the occurrences of a USR in one or more stores, scanned together"
+    )
+
+    @Option(help: "A store to search, repeated for each store", transform: URL.init(fileURLWithPath:))
+    var indexStorePath: [URL]
+
+    @Option(help: "USR of the symbol")
+    var usr: String
+
+    @Flag(help: "Only print definitions")
+    var definitions: Bool = false
+
+    @Flag(help: "Only print references")
+    var references: Bool = false
+
+    @Flag(help: "Search system records too")
+    var includeSystem: Bool = false
+
+    func validate() throws {
+        guard !indexStorePath.isEmpty else {
+            throw ValidationError("Pass at least one --index-store-path")
+        }
+    }
+
+    func run() throws {
+        let federation = try IndexStoreFederation.open(stores: indexStorePath, lib: .shared)
+        var roles: IndexStoreOccurrence.Role = []
+        if definitions { roles.insert(.definition) }
+        if references { roles.insert(.reference) }
+        let occurrences = try federation.occurrences(
+            ofUSR: usr,
+            roles: roles.isEmpty ? nil : roles,
+            includeSystem: includeSystem
+        )
+        for occurrence in occurrences {
+            let location = occurrence.value.location
+            print("\(location.path ?? ""):\(location.line):\(location.column): \(occurrence.value.roles.names.joined(separator: ",")) | store = \(occurrence.store.path.path)")
+        }
+    }
+}
+
+struct Serve: ParsableCommand {
+
+    static var configuration = CommandConfiguration(
+        abstract: "Answer queries on a Unix domain socket, keeping the store and its indexes in memory"
+    )
+
+    @OptionGroup()
+    var options: IndexDumpTool.Options
+
+    @Option(help: "Path of the Unix domain socket to listen on")
+    var socket: String
+
+    @Flag(help: "Index system records too")
+    var includeSystem: Bool = false
+
+    func run() throws {
+        let indexStore = try options.getIndexStore()
+        defer { options.printStatistics(of: indexStore) }
+        let engine = IndexStoreQueryEngine(store: indexStore, includeSystem: includeSystem)
+        try engine.warm()
+        indexStore.startUnitEventListening { notification in
+            if !notification.isInitial {
+                engine.invalidate(units: notification.events.map(\.unit))
+            }
+        }
+        defer { indexStore.stopUnitEventListening() }
+
+        let server = try IndexStoreQueryServer(engine: engine, socketPath: socket)
+        var signalSources: [DispatchSourceSignal] = []
+        for signalNumber in [SIGINT, SIGTERM] {
+            signal(signalNumber, SIG_IGN)
+            let source = DispatchSource.makeSignalSource(signal: signalNumber)
+            source.setEventHandler { server.stop() }
+            source.resume()
+            signalSources.append(source)
+        }
+        FileHandle.standardError.write(Data("Listening on \(socket)\n".utf8))
+        try server.run()
+        signalSources.forEach { $0.cancel() }
+    }
+}
+
+struct Query: ParsableCommand {
+
+    static var configuration = CommandConfiguration(
+        abstract: "Send queries to a running serve command"
+    )
+
+    @Option(help: "Path of the socket the server listens on")
+    var socket: String
+
+    @Option(help: "Print the references of this USR")
+    var references: [String] = []
+
+    @Option(help: "Print the definitions of symbols with this name")
+    var definitions: [String] = []
+
+    @Option(help: "Print the units built from this source file")
+    var units: [String] = []
+
+    @Option(help: "Print the occurrences of PATH:FIRST-LAST, a range of lines of a source file")
+    var lines: [String] = []
+
+    func validate() throws {
+        for range in lines where Self.parseLines(range) == nil {
+            throw ValidationError("Invalid line range '\(range)', expected PATH:FIRST-LAST")
+        }
+    }
+
+    func run() throws {
+        var queries: [IndexStoreQuery] = []
+        queries += references.map { IndexStoreQuery.references(usr: $0) }
+        queries += definitions.map { IndexStoreQuery.definitions(name: $0) }
+        queries += units.map { IndexStoreQuery.units(path: $0) }
+        queries += lines.compactMap(Self.parseLines).map { IndexStoreQuery.occurrences(path: $0.path, lines: $0.lines) }
+
+        let client = try IndexStoreQueryClient(socketPath: socket)
+        var failed = false
+        for result in try client.run(queries) {
+            switch result {
+            case .occurrences(let occurrences):
+                for occurrence in occurrences {
+                    print("\(occurrence.path ?? ""):\(occurrence.line):\(occurrence.column): \(occurrence.roles.names.joined(separator: ",")) \(occurrence.name ?? "") | usr = \(occurrence.usr)")
+                }
+            case .units(let units):
+                units.forEach { print($0) }
+            case .failure(let message):
+                FileHandle.standardError.write(Data("error: \(message)\n".utf8))
+                failed = true
+            }
+        }
+        if failed {
+            throw ExitCode.failure
+        }
+    }
+
+    private static func parseLines(_ argument: String) -> (path: String, lines: ClosedRange<Int64>)? {
+        guard let colon = argument.lastIndex(of: ":") else { return nil }
+        let bounds = argument[argument.index(after: colon)...].split(separator: "-", omittingEmptySubsequences: false)
+        guard bounds.count == 2, let first = Int64(bounds[0]), let last = Int64(bounds[1]), first <= last else {
+            return nil
         }
+        return (String(argument[..<colon]), first...last)
     }
 }
 
-func dumpRecord(_ record: IndexStoreUnit.Dependency.Record, indexStore: IndexStore) throws {
-    print("----------Symbols----------")
-    try indexStore.forEachSymbols(for: record) { symbol -> Bool in
-        print("| usr = \(symbol.usr ?? "") | name = \(symbol.name ?? "") | kind = \(symbol.kind) | subKind = \(symbol.subKind) | language = \(symbol.language) |")
+func dumpRecord(
+    _ record: IndexStoreUnit.Dependency.Record,
+    indexStore: IndexStore,
+    encoder: inout DumpEncoder,
+    into buffer: inout OutputBuffer
+) throws {
+    encoder.beginSymbols(into: &buffer)
+    try indexStore.forEachSymbolRefs(for: record) { symbol -> Bool in
+        encoder.symbol(symbol, into: &buffer)
         return true
     }
-    print("----------Occurrences----------")
-    try indexStore.forEachOccurrences(for: record) { (occ) -> Bool in
-        print("| roles = \(occ.roles) | usr = \(occ.symbol.usr ?? "") | location = \(occ.location.path ?? ""):\(occ.location.line):\(occ.location.column) |")
+    encoder.beginOccurrences(into: &buffer)
+    try indexStore.forEachOccurrenceRefs(for: record) { occurrence -> Bool in
+        encoder.occurrence(occurrence, into: &buffer)
         return true
     }
 }
@@ -0,0 +1,87 @@
+import Foundation
+
+struct BenchmarkResult: Codable {
+    var name: String
+    /// Wall-clock time of each iteration.
+    var seconds: [Double]
+    /// Benchmark-specific values, such as visited occurrences or a dedup ratio.
+    var metrics: [String: Double]
+    /// Peak resident memory of the process after the benchmark ran. See
+    /// `BenchmarkReport.isolatesBenchmarks` for what it covers.
+    var peakResidentBytes: Int64
+
+    var median: Double {
+        let sorted = seconds.sorted()
+        guard !sorted.isEmpty else { return 0 }
+        let middle = sorted.count / 2
+        return sorted.count % 2 == 1 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2
+    }
+
+    var minimum: Double {
+        seconds.min() ?? 0
+    }
+}
+
+struct BenchmarkReport: Codable {
+    var date: Date
+    var project: SyntheticProjectConfiguration?
+    var indexStorePath: String
+    var processorCount: Int
+    var operatingSystem: String
+    /// When `true`, each benchmark ran in its own process and its peak
+    /// resident size is its own. Otherwise peaks are running maxima over the
+    /// benchmarks run before. `nil` in reports of earlier versions, which
+    /// did not isolate benchmarks.
+    var isolatesBenchmarks: Bool?
+    var results: [BenchmarkResult]
+
+    func write(to url: URL) throws {
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+        encoder.dateEncodingStrategy = .iso8601
+        try encoder.encode(self).write(to: url, options: .atomic)
+    }
+
+    static func read(from url: URL) throws -> BenchmarkReport {
+        let decoder = JSONDecoder()
+        decoder.dateDecodingStrategy = .iso8601
+        return try decoder.decode(BenchmarkReport.self, from: Data(contentsOf: url))
+    }
+}
+
+/// Median time change of a benchmark between two reports.
+struct BenchmarkComparison {
+    var name: String
+    var baseline: Double
+    var current: Double
+
+    /// Relative change in percent; positive when `current` is slower.
+    var change: Double {
+        baseline == 0 ? 0 : (current - baseline) / baseline * 100
+    }
+
+    static func compare(baseline: BenchmarkReport, current: BenchmarkReport) -> [BenchmarkComparison] {
+        let baselineResults = Dictionary(baseline.results.map { ($0.name, $0) }, uniquingKeysWith: { first, _ in first })
+        return current.results.compactMap { result in
+            guard let base = baselineResults[result.name] else { return nil }
+            return BenchmarkComparison(name: result.name, baseline: base.median, current: result.median)
+        }
+    }
+}
+
+/// Peak resident set size of the process in bytes.
+func peakResidentBytes() -> Int64 {
+    #if os(Linux)
+    // VmHWM is reported in kB.
+    guard let status = try? String(contentsOfFile: "/proc/self/status", encoding: .utf8),
+          let line = status.split(separator: "\n").first(where: { $0.hasPrefix("VmHWM:") }),
+          let kilobytes = line.split(whereSeparator: { $0 == " " || $0 == "\t" }).dropFirst().first.flatMap({ Int64($0) }) else {
+        return 0
+    }
+    return kilobytes * 1024
+    #else
+    var usage = rusage()
+    guard getrusage(RUSAGE_SELF, &usage) == 0 else { return 0 }
+    return Int64(usage.ru_maxrss)
+    #endif
+}
@@ -0,0 +1,451 @@
+import SwiftIndexStore
+import _CBenchmarkSupport
+import Foundation
+
+/// Runs the benchmarks whose name matches a filter and records their results.
+final class BenchmarkRunner {
+    let lib: LibIndexStore
+    let indexStorePath: URL
+    let iterations: Int
+    let filter: String?
+    /// Runs only the benchmark with this exact name.
+    let only: String?
+    /// Records the names of the selected benchmarks without running them.
+    let listsNames: Bool
+    private(set) var results: [BenchmarkResult] = []
+    private(set) var names: [String] = []
+
+    init(
+        lib: LibIndexStore,
+        indexStorePath: URL,
+        iterations: Int,
+        filter: String?,
+        only: String? = nil,
+        listsNames: Bool = false
+    ) {
+        self.lib = lib
+        self.indexStorePath = indexStorePath
+        self.iterations = max(1, iterations)
+        self.filter = filter
+        self.only = only
+        self.listsNames = listsNames
+    }
+
+    /// Opens a store with cold reader caches, so iterations don't benefit
+    /// from each other.
+    func openStore() throws -> IndexStore {
+        try IndexStore.open(store: indexStorePath, lib: lib)
+    }
+
+    /// Times `body` over every iteration, each with a fresh store. `body`
+    /// returns metrics describing the work done, which should be the same on
+    /// every iteration apart from timings `body` takes itself; those of the
+    /// last iteration are kept. The peak resident size is sampled afterwards, so it
+    /// only belongs to this benchmark when it is the only one the process runs.
+    func measure(_ name: String, _ body: (IndexStore) throws -> [String: Double]) throws {
+        guard isSelected(name) else {
+            return
+        }
+        if listsNames {
+            names.append(name)
+            return
+        }
+        var seconds: [Double] = []
+        var metrics: [String: Double] = [:]
+        for _ in 0..<iterations {
+            let store = try openStore()
+            let start = DispatchTime.now().uptimeNanoseconds
+            metrics = try body(store)
+            seconds.append(Double(DispatchTime.now().uptimeNanoseconds - start) / 1e9)
+        }
+        let result = BenchmarkResult(
+            name: name,
+            seconds: seconds,
+            metrics: metrics,
+            peakResidentBytes: peakResidentBytes()
+        )
+        results.append(result)
+        FileHandle.standardError.write(Data(
+            "\(name): median \(String(format: "%.4f", result.median))s \(metrics.sorted { $0.key < $1.key })\n".utf8
+        ))
+    }
+
+    /// Adds the heap allocations `body` makes to its metrics, in total and
+    /// per visited occurrence. Allocations of other threads are counted too,
+    /// so only use it around single-threaded scans.
+    func countingAllocations(_ body: () throws -> [String: Double]) rethrows -> [String: Double] {
+        guard swiftindexstore_allocation_counter_is_available() else {
+            return try body()
+        }
+        swiftindexstore_allocation_counter_start()
+        var metrics = try body()
+        let allocations = Double(swiftindexstore_allocation_counter_stop())
+        metrics["allocations"] = allocations
+        if let occurrences = metrics["occurrences"], occurrences > 0 {
+            metrics["allocationsPerOccurrence"] = allocations / occurrences
+        }
+        return metrics
+    }
+
+    /// Whether the benchmark `name` passes `filter` and `only`.
+    func isSelected(_ name: String) -> Bool {
+        if let filter, !name.contains(filter) {
+            return false
+        }
+        if let only, name != only {
+            return false
+        }
+        return true
+    }
+
+    /// Whether `measure` would run any of the benchmarks `names`, so that
+    /// their shared inputs are only prepared when needed.
+    func runs(any names: [String]) -> Bool {
+        !listsNames && names.contains(where: isSelected)
+    }
+}
+
+extension BenchmarkRunner {
+
+    func runAll(workerCounts: [Int], scratchDirectory: URL) throws {
+        try measureTraversal()
+        try measureDecoding()
+        try measureScaling(workerCounts: workerCounts)
+        try measureLineRanges()
+        try measurePointQueries()
+        try measureAnalyses(scratchDirectory: scratchDirectory)
+    }
+
+    private func measureTraversal() throws {
+        try measure("units-enumeration") { store in
+            var units = 0
+            store.forEachUnits { _ in
+                units += 1
+                return true
+            }
+            return ["units": Double(units)]
+        }
+
+        try measure("record-dependencies") { store in
+            var dependencies = 0
+            try store.forEachUnits { unit in
+                try store.forEachRecordDependencies(for: unit) { _ in
+                    dependencies += 1
+                    return true
+                }
+                return true
+            }
+            return ["dependencies": Double(dependencies)]
+        }
+
+        try measure("record-ownership") { store in
+            let ownership = try store.recordOwnership()
+            return [
+                "recordDependencies": Double(ownership.dependencyCount),
+                "distinctRecords": Double(ownership.distinctRecordCount),
+                "dedupRatio": ownership.dedupRatio,
+            ]
+        }
+    }
+
+    private func measureDecoding() throws {
+        // Every record dependency of every unit, as a naive walk would scan
+        // them, against each distinct record once.
+        try measure("occurrence-scan-per-unit") { store in
+            var occurrences = 0
+            try store.forEachUnits { unit in
+                try store.forEachRecordDependencies(for: unit) { dependency in
+                    guard case .record(let record) = dependency else { return true }
+                    try store.forEachOccurrenceRefs(for: record) { _ in
+                        occurrences += 1
+                        return true
+                    }
+                    return true
+                }
+                return true
+            }
+            return ["occurrences": Double(occurrences)]
+        }
+
+        try measure("occurrence-scan-distinct") { store in
+            var occurrences = 0
+            try store.forEachDistinctRecords { entry in
+                try store.forEachOccurrenceRefs(for: entry.record) { _ in
+                    occurrences += 1
+                    return true
+                }
+                return true
+            }
+            return ["occurrences": Double(occurrences)]
+        }
+
+        // Materialized symbols and occurrences against borrowed refs.
+        func decodeMaterialized(_ store: IndexStore) throws -> [String: Double] {
+            var symbols = 0
+            var occurrences = 0
+            try store.forEachDistinctRecords { entry in
+                try store.forEachSymbols(for: entry.record) { symbol in
+                    symbols += symbol.usr == nil ? 0 : 1
+                    return true
+                }
+                try store.forEachOccurrences(for: entry.record) { occurrence in
+                    occurrences += occurrence.symbol.usr == nil ? 0 : 1
+                    return true
+                }
+                return true
+            }
+            return ["symbols": Double(symbols), "occurrences": Double(occurrences)]
+        }
+
+        try measure("record-decoding-materialized") { store in
+            try countingAllocations { try decodeMaterialized(store) }
+        }
+
+        // The same scan while instrumentation is running, to track its cost.
+        try measure("record-decoding-instrumented") { store in
+            IndexStoreInstrumentation.start()
+            defer { IndexStoreInstrumentation.stop() }
+            return try decodeMaterialized(store)
+        }
+
+        try measure("record-decoding-refs") { store in
+            try countingAllocations {
+                var symbols = 0
+                var occurrences = 0
+                try store.forEachDistinctRecords { entry in
+                    try store.forEachSymbolRefs(for: entry.record) { symbol in
+                        symbols += symbol.usr.isNull ? 0 : 1
+                        return true
+                    }
+                    try store.forEachOccurrenceRefs(for: entry.record) { occurrence in
+                        occurrences += occurrence.symbol.usr.isNull ? 0 : 1
+                        return true
+                    }
+                    return true
+                }
+                return ["symbols": Double(symbols), "occurrences": Double(occurrences)]
+            }
+        }
+
+        try measure("usr-strings") { store in
+            var bytes = 0
+            try store.forEachDistinctRecords { entry in
+                try store.forEachOccurrenceRefs(for: entry.record) { occurrence in
+                    bytes += occurrence.symbol.usr.string?.utf8.count ?? 0
+                    return true
+                }
+                return true
+            }
+            return ["bytes": Double(bytes)]
+        }
+
+        try measure("usr-interning") { store in
+            let interner = IndexStoreStringInterner()
+            try store.forEachDistinctRecords { entry in
+                try store.forEachOccurrenceRefs(for: entry.record) { occurrence in
+                    _ = interner.intern(occurrence.symbol.usr)
+                    return true
+                }
+                return true
+            }
+            return ["strings": Double(interner.count)]
+        }
+
+        try measure("relation-walk") { store in
+            var relations = 0
+            try store.forEachDistinctRecords { entry in
+                try store.forEachOccurrenceRefs(for: entry.record) { occurrence in
+                    occurrence.forEachRelation { _, _ in
+                        relations += 1
+                        return true
+                    }
+                    return true
+                }
+                return true
+            }
+            return ["relations": Double(relations)]
+        }
+    }
+
+    private func measureScaling(workerCounts: [Int]) throws {
+        for workerCount in workerCounts {
+            try measure("concurrent-scan-\(workerCount)-workers") { store in
+                let counts = try store.concurrentMapDistinctRecords(workerCount: workerCount) { entry -> Int in
+                    var occurrences = 0
+                    try store.forEachOccurrenceRefs(for: entry.record) { _ in
+                        occurrences += 1
+                        return true
+                    }
+                    return occurrences
+                }
+                return ["occurrences": Double(counts.reduce(0, +))]
+            }
+        }
+    }
+
+    /// Looks up ten-line windows of every record, through the line-range API
+    /// and by filtering a full scan.
+    private func measureLineRanges() throws {
+        var records: [IndexStoreUnit.Dependency.Record] = []
+        if runs(any: ["line-range-queries", "line-range-full-scan"]) {
+            records = try openStore().recordOwnership(includeSystem: false).records.map(\.record)
+        }
+        let windows = stride(from: Int64(1), through: 100, by: 10).map { $0...($0 + 9) }
+
+        try measure("line-range-queries") { store in
+            var occurrences = 0
+            var queries = 0
+            for record in records {
+                for lines in windows {
+                    occurrences += try store.occurrences(for: record, lines: lines).count
+                    queries += 1
+                }
+            }
+            return ["queries": Double(queries), "occurrences": Double(occurrences)]
+        }
+
+        try measure("line-range-full-scan") { store in
+            var occurrences = 0
+            var queries = 0
+            for record in records {
+                for lines in windows {
+                    try store.forEachOccurrences(for: record) { occurrence in
+                        occurrences += lines.contains(occurrence.location.line) ? 1 : 0
+                        return true
+                    }
+                    queries += 1
+                }
+            }
+            return ["queries": Double(queries), "occurrences": Double(occurrences)]
+        }
+    }
+
+    /// Looks up the occurrences at positions spread over the largest file,
+    /// through the point query API and by scanning its records, and reports
+    /// the latency of a single query.
+    private func measurePointQueries() throws {
+        var path = ""
+        var positions: [(line: Int64, column: Int64)] = []
+        if runs(any: ["point-queries", "point-queries-full-scan"]) {
+            let store = try openStore()
+            let records = try store.recordOwnership(includeSystem: false).records.map(\.record)
+            var largest = records.first { $0.filePath?.hasSuffix("/" + SyntheticProject.largeFileName) ?? false }
+            if largest == nil {
+                // An existing store: take the record with the most occurrences.
+                var largestCount = -1
+                for record in records {
+                    var count = 0
+                    try store.forEachOccurrenceRefs(for: record) { _ in
+                        count += 1
+                        return true
+                    }
+                    if count > largestCount {
+                        largest = record
+                        largestCount = count
+                    }
+                }
+            }
+            if let largest, let filePath = largest.filePath {
+                path = filePath
+                // The position of every few occurrences.
+                let occurrences = try store.occurrences(for: largest)
+                let step = max(1, occurrences.count / 200)
+                positions = stride(from: 0, to: occurrences.count, by: step).map {
+                    (line: occurrences[$0].location.line, column: occurrences[$0].location.column)
+                }
+            }
+        }
+
+        func latencies(_ query: (Int64, Int64) throws -> Int) rethrows -> [String: Double] {
+            var seconds: [Double] = []
+            var occurrences = 0
+            for position in positions {
+                let start = DispatchTime.now().uptimeNanoseconds
+                occurrences += try query(position.line, position.column)
+                seconds.append(Double(DispatchTime.now().uptimeNanoseconds - start) / 1e9)
+            }
+            seconds.sort()
+            guard !seconds.isEmpty else { return ["queries": 0] }
+            return [
+                "queries": Double(seconds.count),
+                "occurrences": Double(occurrences),
+                "medianSecondsPerQuery": seconds[seconds.count / 2],
+                "p95SecondsPerQuery": seconds[min(seconds.count - 1, seconds.count * 95 / 100)],
+                "maxSecondsPerQuery": seconds[seconds.count - 1],
+            ]
+        }
+
+        // Both look records up by path, so the path map is built before the
+        // timed queries.
+        try measure("point-queries") { store in
+            _ = try store.records(forPath: path)
+            return try latencies { line, column in
+                try store.occurrences(atPath: path, line: line, column: column).count
+            }
+        }
+
+        try measure("point-queries-full-scan") { store in
+            _ = try store.records(forPath: path)
+            return try latencies { line, column in
+                var occurrences = 0
+                for record in try store.records(forPath: path) {
+                    try store.forEachOccurrences(for: record) { occurrence in
+                        let location = occurrence.location
+                        occurrences += location.line == line && location.column == column ? 1 : 0
+                        return true
+                    }
+                }
+                return occurrences
+            }
+        }
+    }
+
+    private func measureAnalyses(scratchDirectory: URL) throws {
+        try measure("unit-graph") { store in
+            let graph = try store.unitGraph()
+            return ["units": Double(graph.units.count), "edges": Double(graph.edgeCount)]
+        }
+
+        try measure("relation-graph") { store in
+            let graph = try store.relationGraph()
+            return ["nodes": Double(graph.nodes.count), "edges": Double(graph.edgeCount)]
+        }
+
+        try measure("usr-index-build") { store in
+            let index = try IndexStoreUSRIndex.build(
+                from: store,
+                at: scratchDirectory.appendingPathComponent("usr-index")
+            )
+            return ["symbols": Double(index.symbolCount), "occurrences": Double(index.occurrenceCount)]
+        }
+
+        try measure("unused-declarations") { store in
+            let unused = try store.unusedDeclarations()
+            return ["unused": Double(unused.count)]
+        }
+
+        // The nested loops and USR string dictionaries the analysis replaces.
+        try measure("unused-declarations-naive") { store in
+            var definitions = Set<String>()
+            var references = Set<String>()
+            try store.forEachUnits(includeSystem: false) { unit in
+                try store.forEachRecordDependencies(for: unit) { dependency in
+                    guard case .record(let record) = dependency, !record.isSystem else { return true }
+                    try store.forEachOccurrences(for: record) { occurrence in
+                        guard let usr = occurrence.symbol.usr else { return true }
+                        if occurrence.roles.contains(.definition), !occurrence.roles.contains(.implicit) {
+                            definitions.insert(usr)
+                        }
+                        if occurrence.roles.contains(.reference) {
+                            references.insert(usr)
+                        }
+                        return true
+                    }
+                    return true
+                }
+                return true
+            }
+            return ["unused": Double(definitions.subtracting(references).count)]
+        }
+    }
+}
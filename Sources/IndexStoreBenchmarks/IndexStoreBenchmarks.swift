@@ -0,0 +1,210 @@
+import SwiftIndexStore
+import Foundation
+import ArgumentParser
+
+struct IndexStoreBenchmarks: ParsableCommand {
+
+    struct ProjectOptions: ParsableArguments {
+        @Option(help: "Number of generated modules")
+        var modules: Int = 8
+
+        @Option(help: "Number of files per generated module")
+        var files: Int = 50
+
+        @Option(help: "Number of methods and functions per generated file")
+        var symbols: Int = 20
+
+        @Option(help: "Length of the generated class inheritance chains")
+        var hierarchyDepth: Int = 16
+
+        @Option(help: "Number of functions of the large generated file the point queries look into")
+        var largeFileSymbols: Int = 5000
+
+        var configuration: SyntheticProjectConfiguration {
+            .init(
+                modules: modules,
+                filesPerModule: files,
+                symbolsPerFile: symbols,
+                hierarchyDepth: hierarchyDepth,
+                largeFileSymbols: largeFileSymbols
+            )
+        }
+    }
+
+    static var configuration = CommandConfiguration(
+        commandName: "index-store-benchmarks",
+        subcommands: [Run.self, Generate.self, Compare.self],
+        defaultSubcommand: Run.self
+    )
+}
+
+extension IndexStoreBenchmarks {
+
+    struct Run: ParsableCommand {
+
+        static var configuration = CommandConfiguration(
+            abstract: "Generate a synthetic project, or use an existing store, and benchmark it"
+        )
+
+        @OptionGroup()
+        var project: ProjectOptions
+
+        @Option(help: "Benchmark this store instead of generating one", transform: URL.init(fileURLWithPath:))
+        var indexStorePath: URL?
+
+        @Option(help: "Number of times each benchmark runs")
+        var iterations: Int = 5
+
+        @Option(help: "Only run benchmarks whose name contains this string")
+        var filter: String?
+
+        @Option(help: "Worker counts of the scaling benchmarks")
+        var workers: [Int] = [1, 2, 4, 8, 16]
+
+        @Option(help: "Write the results as JSON to this path", transform: URL.init(fileURLWithPath:))
+        var output: URL?
+
+        @Flag(help: "Run every benchmark in this process; peak memory is then a running maximum over benchmarks")
+        var inProcess: Bool = false
+
+        /// Set on the process running a single benchmark for its parent.
+        @Option(help: .hidden)
+        var only: String?
+
+        func run() throws {
+            let scratch = FileManager.default.temporaryDirectory
+                .appendingPathComponent("index-store-benchmarks-\(ProcessInfo.processInfo.processIdentifier)")
+            try FileManager.default.createDirectory(at: scratch, withIntermediateDirectories: true)
+            defer { try? FileManager.default.removeItem(at: scratch) }
+
+            var configuration: SyntheticProjectConfiguration?
+            let storePath: URL
+            if let indexStorePath {
+                storePath = indexStorePath
+            } else {
+                let generated = SyntheticProject(configuration: project.configuration, directory: scratch)
+                try generated.generate(
+                    swiftc: findSwiftc(),
+                    sdkPath: findSDKPath(),
+                    jobs: ProcessInfo.processInfo.activeProcessorCount
+                )
+                configuration = project.configuration
+                storePath = generated.indexStorePath
+            }
+
+            let isolates = !inProcess && only == nil
+            let runner = BenchmarkRunner(
+                lib: try LibIndexStore.shared,
+                indexStorePath: storePath,
+                iterations: iterations,
+                filter: filter,
+                only: only,
+                listsNames: isolates
+            )
+            try runner.runAll(workerCounts: workers, scratchDirectory: scratch)
+            var results = runner.results
+            if isolates {
+                results = try runner.names.flatMap { name in
+                    try runIsolated(name, storePath: storePath, scratch: scratch)
+                }
+            }
+
+            let report = BenchmarkReport(
+                date: Date(),
+                project: configuration,
+                indexStorePath: storePath.path,
+                processorCount: ProcessInfo.processInfo.activeProcessorCount,
+                operatingSystem: ProcessInfo.processInfo.operatingSystemVersionString,
+                isolatesBenchmarks: !inProcess,
+                results: results
+            )
+            if let output {
+                try report.write(to: output)
+            }
+        }
+
+        /// Runs the benchmark `name` in a new process of this executable, so
+        /// that its peak resident size isn't raised by the benchmarks before it.
+        private func runIsolated(_ name: String, storePath: URL, scratch: URL) throws -> [BenchmarkResult] {
+            let output = scratch.appendingPathComponent("result-\(UUID().uuidString).json")
+            defer { try? FileManager.default.removeItem(at: output) }
+            var arguments = [
+                "run",
+                "--index-store-path", storePath.path,
+                "--iterations", "\(iterations)",
+                "--only", name,
+                "--output", output.path,
+            ]
+            for workerCount in workers {
+                arguments += ["--workers", "\(workerCount)"]
+            }
+            try runCommand(Bundle.main.executablePath ?? CommandLine.arguments[0], arguments)
+            return try BenchmarkReport.read(from: output).results
+        }
+    }
+
+    struct Generate: ParsableCommand {
+
+        static var configuration = CommandConfiguration(
+            abstract: "Generate and index a synthetic project"
+        )
+
+        @OptionGroup()
+        var project: ProjectOptions
+
+        @Argument(help: "Directory to generate the project in", transform: URL.init(fileURLWithPath:))
+        var directory: URL
+
+        func run() throws {
+            let generated = SyntheticProject(configuration: project.configuration, directory: directory)
+            try generated.generate(
+                swiftc: findSwiftc(),
+                sdkPath: findSDKPath(),
+                jobs: ProcessInfo.processInfo.activeProcessorCount
+            )
+            print(generated.indexStorePath.path)
+        }
+    }
+
+    struct Compare: ParsableCommand {
+
+        static var configuration = CommandConfiguration(
+            abstract: "Compare the median times of two result files"
+        )
+
+        @Argument(help: "Results of the baseline commit", transform: URL.init(fileURLWithPath:))
+        var baseline: URL
+
+        @Argument(help: "Results of the commit under test", transform: URL.init(fileURLWithPath:))
+        var current: URL
+
+        @Option(help: "Slowdown in percent above which a benchmark counts as a regression")
+        var threshold: Double = 10
+
+        @Flag(help: "Exit with a non-zero status when a benchmark regressed")
+        var failOnRegression: Bool = false
+
+        func run() throws {
+            let comparisons = BenchmarkComparison.compare(
+                baseline: try BenchmarkReport.read(from: baseline),
+                current: try BenchmarkReport.read(from: current)
+            )
+            var regressions = 0
+            for comparison in comparisons {
+                let isRegression = comparison.change > threshold
+                regressions += isRegression ? 1 : 0
+                let line = [
+                    comparison.name.padding(toLength: 36, withPad: " ", startingAt: 0),
+                    String(format: "%10.4fs", comparison.baseline),
+                    String(format: "%10.4fs", comparison.current),
+                    String(format: "%+8.1f%%", comparison.change),
+                    isRegression ? "  REGRESSION" : "",
+                ]
+                print(line.joined(separator: " "))
+            }
+            if failOnRegression, regressions > 0 {
+                throw ExitCode.failure
+            }
+        }
+    }
+}
@@ -0,0 +1,213 @@
+import Foundation
+
+/// Shape of a generated project.
+struct SyntheticProjectConfiguration: Codable, Equatable {
+    var modules: Int
+    var filesPerModule: Int
+    var symbolsPerFile: Int
+    /// Length of the class inheritance chains, which run across files and
+    /// modules.
+    var hierarchyDepth: Int
+    /// Number of functions of the one large file of the first module, which
+    /// the point query benchmarks look into. `nil` in reports of earlier
+    /// versions, which didn't generate it.
+    var largeFileSymbols: Int?
+}
+
+/// Generates Swift sources with deep class hierarchies and heavy
+/// cross-references, and indexes them with the local toolchain.
+///
+/// Module `i` imports module `i - 1`. File `j` of a module declares one
+/// class overriding the `symbolsPerFile` methods of the class declared by the
+/// previous file, unless it starts a new chain, and as many free functions
+/// calling those methods and the functions of the previous file. Each file
+/// also declares a function nothing calls. The first module also has a large
+/// file of functions calling each other, one per line.
+struct SyntheticProject {
+    let configuration: SyntheticProjectConfiguration
+    let directory: URL
+
+    var indexStorePath: URL {
+        directory.appendingPathComponent("IndexStore")
+    }
+
+    private var sourcesDirectory: URL {
+        directory.appendingPathComponent("Sources")
+    }
+
+    private var buildDirectory: URL {
+        directory.appendingPathComponent("Build")
+    }
+
+    func generate(swiftc: URL, sdkPath: String?, jobs: Int) throws {
+        let fileManager = FileManager.default
+        for path in [indexStorePath, sourcesDirectory, buildDirectory] {
+            try fileManager.createDirectory(at: path, withIntermediateDirectories: true)
+        }
+        for module in 0..<configuration.modules {
+            let moduleDirectory = sourcesDirectory.appendingPathComponent(moduleName(module))
+            let objectDirectory = buildDirectory.appendingPathComponent(moduleName(module))
+            try fileManager.createDirectory(at: moduleDirectory, withIntermediateDirectories: true)
+            try fileManager.createDirectory(at: objectDirectory, withIntermediateDirectories: true)
+            var files: [String] = []
+            for file in 0..<configuration.filesPerModule {
+                let url = moduleDirectory.appendingPathComponent("File\(file).swift")
+                try source(module: module, file: file).write(to: url, atomically: true, encoding: .utf8)
+                files.append(url.path)
+            }
+            if module == 0, let symbols = configuration.largeFileSymbols, symbols > 0 {
+                let url = moduleDirectory.appendingPathComponent(Self.largeFileName)
+                try largeSource(symbols: symbols).write(to: url, atomically: true, encoding: .utf8)
+                files.append(url.path)
+            }
+
+            var arguments = [
+                "-c", "-parse-as-library", "-j", String(max(1, jobs)),
+                "-module-name", moduleName(module),
+                "-emit-module", "-emit-module-path",
+                buildDirectory.appendingPathComponent("\(moduleName(module)).swiftmodule").path,
+                "-I", buildDirectory.path,
+                "-index-store-path", indexStorePath.path,
+            ]
+            if let sdkPath {
+                arguments += ["-sdk", sdkPath]
+            }
+            try runCommand(swiftc.path, arguments + files, in: objectDirectory)
+        }
+    }
+
+    static let largeFileName = "LargeFile.swift"
+
+    private func moduleName(_ module: Int) -> String {
+        "Module\(module)"
+    }
+
+    private func className(module: Int, file: Int) -> String {
+        "Class\(module)_\(file)"
+    }
+
+    /// The class file `file` of `module` inherits from, if any.
+    private func base(module: Int, file: Int) -> (module: Int, file: Int)? {
+        let position = module * configuration.filesPerModule + file
+        guard position % max(1, configuration.hierarchyDepth) != 0 else { return nil }
+        return previous(module: module, file: file)
+    }
+
+    private func previous(module: Int, file: Int) -> (module: Int, file: Int)? {
+        if file > 0 {
+            return (module, file - 1)
+        }
+        if module > 0 {
+            return (module - 1, configuration.filesPerModule - 1)
+        }
+        return nil
+    }
+
+    func source(module: Int, file: Int) -> String {
+        let symbols = 0..<max(1, configuration.symbolsPerFile)
+        let name = className(module: module, file: file)
+        var lines: [String] = []
+        if module > 0 {
+            lines.append("import \(moduleName(module - 1))")
+            lines.append("")
+        }
+
+        if let base = base(module: module, file: file) {
+            lines.append("open class \(name): \(className(module: base.module, file: base.file)) {")
+            lines.append("    public override init() { super.init() }")
+            for symbol in symbols {
+                lines.append("    open override func method\(symbol)() -> Int { super.method\(symbol)() + \(symbol) }")
+            }
+        } else {
+            lines.append("open class \(name) {")
+            lines.append("    public init() {}")
+            for symbol in symbols {
+                lines.append("    open func method\(symbol)() -> Int { \(symbol) }")
+            }
+        }
+        lines.append("}")
+        lines.append("")
+
+        let previous = self.previous(module: module, file: file)
+        for symbol in symbols {
+            let function = "function\(module)_\(file)_\(symbol)"
+            lines.append("public func \(function)(_ value: \(name)) -> Int {")
+            var body = "value.method\(symbol)()"
+            if symbol > 0 {
+                body += " + function\(module)_\(file)_\(symbol - 1)(value)"
+            }
+            if let previous {
+                let previousClass = className(module: previous.module, file: previous.file)
+                body += " + function\(previous.module)_\(previous.file)_\(symbol)(\(previousClass)())"
+            }
+            lines.append("    \(body)")
+            lines.append("}")
+        }
+        lines.append("")
+        lines.append("public func unused\(module)_\(file)() -> Int { \(name)().method0() }")
+        return lines.joined(separator: "\n") + "\n"
+    }
+
+    func largeSource(symbols: Int) -> String {
+        var lines = ["public func large0(_ value: Int) -> Int { value }"]
+        for symbol in 1..<max(1, symbols) {
+            lines.append("public func large\(symbol)(_ value: Int) -> Int { large\(symbol - 1)(value) + \(symbol) }")
+        }
+        return lines.joined(separator: "\n") + "\n"
+    }
+}
+
+/// Locates `swiftc` from `SWIFTC`, `xcrun` or `PATH`.
+func findSwiftc() throws -> URL {
+    if let path = ProcessInfo.processInfo.environment["SWIFTC"] {
+        return URL(fileURLWithPath: path)
+    }
+    #if os(macOS)
+    let path = try runCommand("/usr/bin/xcrun", ["--find", "swiftc"])
+    #else
+    let path = try runCommand("/usr/bin/env", ["which", "swiftc"])
+    #endif
+    return URL(fileURLWithPath: path.trimmingCharacters(in: .whitespacesAndNewlines))
+}
+
+func findSDKPath() throws -> String? {
+    #if os(macOS)
+    return try runCommand("/usr/bin/xcrun", ["--show-sdk-path"]).trimmingCharacters(in: .whitespacesAndNewlines)
+    #else
+    return nil
+    #endif
+}
+
+struct CommandFailure: Error, CustomStringConvertible {
+    var command: String
+    var status: Int32
+
+    var description: String {
+        "\(command) exited with \(status)"
+    }
+}
+
+/// Runs `executable` and returns its standard output, throwing on failure.
+/// Standard error is forwarded, so compiler diagnostics stay visible.
+@discardableResult
+func runCommand(_ executable: String, _ arguments: [String], in directory: URL? = nil) throws -> String {
+    let process = Process()
+    process.executableURL = URL(fileURLWithPath: executable)
+    process.arguments = arguments
+    if let directory {
+        process.currentDirectoryURL = directory
+    }
+    let output = Pipe()
+    process.standardOutput = output
+    try process.run()
+    let data = output.fileHandleForReading.readDataToEndOfFile()
+    process.waitUntilExit()
+    let text = String(decoding: data, as: UTF8.self)
+    guard process.terminationStatus == 0 else {
+        throw CommandFailure(
+            command: ([executable] + arguments.prefix(8)).joined(separator: " "),
+            status: process.terminationStatus
+        )
+    }
+    return text
+}
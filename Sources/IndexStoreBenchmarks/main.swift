@@ -0,0 +1 @@
+IndexStoreBenchmarks.main()
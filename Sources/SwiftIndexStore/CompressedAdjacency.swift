@@ -0,0 +1,67 @@
+/// Adjacency lists in compressed sparse row form: the targets of node `i` are
+/// `targets[offsets[i]..<offsets[i + 1]]`.
+struct CompressedAdjacency {
+    private(set) var offsets: [Int32]
+    private(set) var targets: [Int32]
+
+    /// Builds the lists from `(source, target)` edges. With `deduplicated`,
+    /// the targets of each node are sorted and repeated edges dropped.
+    init(nodeCount: Int, edges: [(Int32, Int32)], deduplicated: Bool = false) {
+        var counts = [Int32](repeating: 0, count: nodeCount + 1)
+        for (source, _) in edges {
+            counts[Int(source) + 1] += 1
+        }
+        for index in 0..<nodeCount {
+            counts[index + 1] += counts[index]
+        }
+        var targets = [Int32](repeating: 0, count: edges.count)
+        var cursor = counts
+        for (source, target) in edges {
+            targets[Int(cursor[Int(source)])] = target
+            cursor[Int(source)] += 1
+        }
+
+        if deduplicated {
+            var uniqueCount = 0
+            var start = 0
+            for node in 0..<nodeCount {
+                let end = Int(counts[node + 1])
+                targets[start..<end].sort()
+                counts[node] = Int32(uniqueCount)
+                for index in start..<end where index == start || targets[index] != targets[index - 1] {
+                    targets[uniqueCount] = targets[index]
+                    uniqueCount += 1
+                }
+                start = end
+            }
+            counts[nodeCount] = Int32(uniqueCount)
+            targets.removeLast(targets.count - uniqueCount)
+        }
+        self.offsets = counts
+        self.targets = targets
+    }
+
+    var edgeCount: Int {
+        targets.count
+    }
+
+    subscript(node: Int) -> ArraySlice<Int32> {
+        targets[Int(offsets[node])..<Int(offsets[node + 1])]
+    }
+
+    /// The nodes reachable from `source`, `source` included, in visiting order.
+    func reachable(from source: Int32) -> [Int32] {
+        var visited = [Bool](repeating: false, count: offsets.count - 1)
+        var stack: [Int32] = [source]
+        var result: [Int32] = []
+        visited[Int(source)] = true
+        while let node = stack.popLast() {
+            result.append(node)
+            for target in self[Int(node)] where !visited[Int(target)] {
+                visited[Int(target)] = true
+                stack.append(target)
+            }
+        }
+        return result
+    }
+}
@@ -0,0 +1,153 @@
+import Foundation
+
+extension IndexStore {
+
+    public static var defaultWorkerCount: Int {
+        ProcessInfo.processInfo.activeProcessorCount
+    }
+
+    /// Applies `transform` to every unit on a pool of `workerCount` workers.
+    ///
+    /// `transform` is called concurrently and must be thread-safe. Results are
+    /// returned in the same order as `forEachUnits(includeSystem:_:)` visits units.
+    public func concurrentMapUnits<T>(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        _ transform: (IndexStoreUnit) throws -> T
+    ) throws -> [T] {
+        let results = try concurrentMap(units(), workerCount: workerCount) { unit -> T? in
+            if !includeSystem, try isSystemUnit(unit) {
+                return nil
+            }
+            return try transform(unit)
+        }
+        return results.compactMap { $0 }
+    }
+
+    /// Applies `transform` to every record dependency of every unit on a pool of
+    /// `workerCount` workers. Each worker opens its own record readers.
+    ///
+    /// `transform` is called concurrently and must be thread-safe. Results are
+    /// returned in unit order, then in dependency order within each unit, which
+    /// matches a serial `forEachUnits` / `forEachRecordDependencies` walk.
+    public func concurrentMapRecords<T>(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        _ transform: (IndexStoreUnit, IndexStoreUnit.Dependency.Record) throws -> T
+    ) throws -> [T] {
+        let perUnit = try concurrentMapUnits(includeSystem: includeSystem, workerCount: workerCount) { unit -> [T] in
+            var results: [T] = []
+            try forEachRecordDependencies(for: unit) { dependency -> Bool in
+                guard case let .record(record) = dependency else { return true }
+                results.append(try transform(unit, record))
+                return true
+            }
+            return results
+        }
+        return perUnit.flatMap { $0 }
+    }
+
+    public func concurrentForEachRecord(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        _ body: (IndexStoreUnit, IndexStoreUnit.Dependency.Record) throws -> Void
+    ) throws {
+        _ = try concurrentMapRecords(includeSystem: includeSystem, workerCount: workerCount, body)
+    }
+
+    // - MARK: Worker Pool
+
+    /// The stack size of worker threads, that of a main thread rather than
+    /// the smaller default of secondary threads.
+    private static let workerStackSize = 8 << 20
+
+    func concurrentMap<Element, T>(
+        _ elements: [Element],
+        workerCount: Int,
+        _ transform: (Element) throws -> T
+    ) throws -> [T] {
+        try Self.concurrentMap(elements, workerCount: workerCount, transform)
+    }
+
+    /// Applies `transform` to `elements` on a pool of `workerCount` workers,
+    /// returning results in element order.
+    ///
+    /// The calling thread is one of the workers and the others are threads of
+    /// their own, so that `workerCount` is honored beyond the number of cores,
+    /// which `DispatchQueue.concurrentPerform` caps it at.
+    static func concurrentMap<Element, T>(
+        _ elements: [Element],
+        workerCount: Int,
+        _ transform: (Element) throws -> T
+    ) throws -> [T] {
+        let workerCount = max(1, min(workerCount, elements.count))
+        if workerCount == 1 {
+            return try elements.map(transform)
+        }
+
+        let queue = WorkQueue(count: elements.count)
+        var results = [T?](repeating: nil, count: elements.count)
+        withoutActuallyEscaping(transform) { transform in
+            results.withUnsafeMutableBufferPointer { buffer in
+                let buffer = buffer
+                let work = {
+                    while let index = queue.dequeue() {
+                        do {
+                            buffer[index] = try transform(elements[index])
+                        } catch {
+                            queue.fail(at: index, error)
+                        }
+                    }
+                }
+                let group = DispatchGroup()
+                for _ in 1..<workerCount {
+                    group.enter()
+                    let thread = Thread {
+                        work()
+                        group.leave()
+                    }
+                    thread.stackSize = workerStackSize
+                    thread.start()
+                }
+                work()
+                group.wait()
+            }
+        }
+        if let error = queue.error {
+            throw error
+        }
+        return results.map { $0! }
+    }
+}
+
+/// Hands out element indices to workers and remembers the failure with the
+/// lowest index so that errors are reported deterministically.
+private final class WorkQueue {
+    private let lock = UnfairLock()
+    private let count: Int
+    private var next = 0
+    private var failure: (index: Int, error: Error)?
+
+    init(count: Int) {
+        self.count = count
+    }
+
+    var error: Error? {
+        lock.perform { failure?.error }
+    }
+
+    func dequeue() -> Int? {
+        lock.perform {
+            guard failure == nil, next < count else { return nil }
+            defer { next += 1 }
+            return next
+        }
+    }
+
+    func fail(at index: Int, _ error: Error) {
+        lock.perform {
+            if let failure, failure.index < index { return }
+            failure = (index, error)
+        }
+    }
+}
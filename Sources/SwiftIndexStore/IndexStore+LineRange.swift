@@ -0,0 +1,156 @@
+import _CIndexStore
+import Foundation
+
+extension IndexStore {
+
+    /// Visits the occurrences of `record` located on `lines`, without
+    /// decoding the occurrences of other lines.
+    public func forEachOccurrences(
+        for record: IndexStoreUnit.Dependency.Record,
+        lines: ClosedRange<Int64>,
+        _ next: (IndexStoreOccurrence) throws -> Bool
+    ) throws {
+        try IndexStoreInstrumentation.measure(.lineRangeOccurrences, next) { next in
+            let firstLine = max(lines.lowerBound, 1)
+            guard firstLine <= lines.upperBound else { return }
+            try lib.bind(.lineRange)
+            typealias Ctx = Context<(
+                next: (IndexStoreOccurrence) throws -> Bool,
+                recordPath: String?,
+                isSystem: Bool,
+                owner: RecordReader
+            )>
+
+            try withRecordReader(for: record) { reader in
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, record.filePath, record.isSystem, reader), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.record_reader_occurrences_in_line_range_apply_f(
+                        reader.reader,
+                        UInt32(clamping: firstLine),
+                        UInt32(clamping: lines.upperBound - firstLine + 1),
+                        ctx
+                    ) { ctx, occurrence -> Bool in
+                        let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                        guard let occ = IndexStore.createOccurrence(
+                            from: occurrence,
+                            recordPath: ctx.content.recordPath,
+                            isSystem: ctx.content.isSystem,
+                            language: nil,
+                            owner: ctx.content.owner,
+                            lib: ctx.lib
+                        ) else { return true }
+                        do { return try ctx.content.next(occ) } catch {
+                            ctx.error = error
+                            return false
+                        }
+                    }
+                    if let error = handler.error {
+                        throw error
+                    }
+                }
+            }
+        }
+    }
+
+    public func occurrences(for record: IndexStoreUnit.Dependency.Record, lines: ClosedRange<Int64>) throws -> [IndexStoreOccurrence] {
+        var result: [IndexStoreOccurrence] = []
+        try forEachOccurrences(for: record, lines: lines) {
+            result.append($0)
+            return true
+        }
+        return result
+    }
+
+    /// The occurrences whose spelled name covers `line`:`column` of the source
+    /// file at `path`, across every record built from that file.
+    ///
+    /// Several occurrences can share a location, e.g. a property and its
+    /// implicit accessors. Occurrences found in more than one record are
+    /// reported once. A column past the end of the closest name, e.g. in
+    /// whitespace or a comment, has no occurrences.
+    public func occurrences(atPath path: String, line: Int64, column: Int64) throws -> [IndexStoreOccurrence] {
+        var result: [IndexStoreOccurrence] = []
+        var resultColumn: Int64 = 0
+        var seen = Set<String>()
+        for record in try records(forPath: path) {
+            try forEachOccurrences(for: record, lines: line...line) { occ in
+                let start = occ.location.column
+                guard occ.location.line == line, start <= column, start >= resultColumn else { return true }
+                if start > resultColumn {
+                    result.removeAll()
+                    seen.removeAll()
+                    resultColumn = start
+                }
+                if seen.insert("\(occ.symbol.usr ?? ""):\(occ.roles.rawValue)").inserted {
+                    result.append(occ)
+                }
+                return true
+            }
+        }
+        let extent = result.map { Self.spelledLength(of: $0.symbol.name, roles: $0.roles) }.max() ?? 0
+        guard column < resultColumn + max(extent, 1) else { return [] }
+        return result
+    }
+
+    /// The length of `name` as written at an occurrence with `roles`.
+    ///
+    /// Accessor prefixes such as `getter:` and argument labels are not
+    /// spelled there, and subscripts are referenced by their opening bracket.
+    /// Initializers count as `init`: a call spelled with the type name shares
+    /// its location with a reference to the type, which covers the rest.
+    /// Names that are keywords may be escaped with backticks, which are
+    /// counted; backticks around other identifiers can't be told from the name.
+    static func spelledLength(of name: String?, roles: IndexStoreOccurrence.Role) -> Int64 {
+        guard var name = name?[...] else { return 0 }
+        for prefix in ["getter:", "setter:", "willSet:", "didSet:", "_modify:", "_read:", "modify:", "read:"] where name.hasPrefix(prefix) {
+            name = name.dropFirst(prefix.count)
+            break
+        }
+        if let first = name.first, !(first == "_" || first.isLetter) {
+            // An operator, followed by its argument labels.
+            return Int64(name.prefix { $0 != "(" }.utf8.count)
+        }
+        // Argument labels of Swift names and selector pieces of Objective-C ones.
+        let baseName = name.prefix { $0 != "(" && $0 != ":" }
+        if baseName == "subscript" {
+            return roles.contains(.definition) || roles.contains(.declaration) ? Int64(baseName.utf8.count) : 1
+        }
+        if escapedKeywords.contains(String(baseName)) {
+            return Int64(baseName.utf8.count) + 2
+        }
+        return Int64(baseName.utf8.count)
+    }
+
+    /// Keywords an identifier of the same name is escaped with backticks for,
+    /// except `init`, `deinit` and `subscript`, which name the declarations.
+    private static let escapedKeywords: Set<String> = [
+        "associatedtype", "class", "enum", "extension", "fileprivate", "func", "import", "inout",
+        "internal", "let", "open", "operator", "private", "precedencegroup", "protocol", "public",
+        "rethrows", "static", "struct", "typealias", "var", "break", "case", "catch", "continue",
+        "default", "defer", "do", "else", "fallthrough", "for", "guard", "if", "in", "repeat",
+        "return", "throw", "switch", "where", "while", "Any", "as", "await", "false", "is", "nil",
+        "self", "Self", "super", "throws", "true", "try",
+    ]
+
+    /// The distinct records whose main file is `path`.
+    ///
+    /// The path to record map is built on first use and kept until
+    /// `invalidateRecordPathMap()` is called or a unit event is received.
+    public func records(forPath path: String) throws -> [IndexStoreUnit.Dependency.Record] {
+        if let map = recordPathMapLock.perform({ recordPathMap }) {
+            return map[path] ?? []
+        }
+        var map: [String: [IndexStoreUnit.Dependency.Record]] = [:]
+        for entry in try recordOwnership().records {
+            guard let filePath = entry.record.filePath else { continue }
+            map[filePath, default: []].append(entry.record)
+        }
+        recordPathMapLock.perform { recordPathMap = map }
+        return map[path] ?? []
+    }
+
+    public func invalidateRecordPathMap() {
+        recordPathMapLock.perform { recordPathMap = nil }
+    }
+}
@@ -0,0 +1,250 @@
+import Foundation
+
+public struct IndexStoreStreamConfiguration {
+    /// Number of elements handed over to the consumer at once.
+    public var batchSize: Int
+    /// Number of batches the producer may run ahead of the consumer before it
+    /// blocks.
+    public var bufferedBatches: Int
+
+    public init(batchSize: Int = 256, bufferedBatches: Int = 4) {
+        self.batchSize = batchSize
+        self.bufferedBatches = bufferedBatches
+    }
+}
+
+/// An asynchronous sequence fed by a producer running on its own thread.
+///
+/// The producer blocks once `bufferedBatches` batches are waiting, so a slow
+/// consumer slows the scan down instead of growing memory. Iteration ends,
+/// and the producer stops at its next batch, when the consuming task is
+/// cancelled or the iterator is discarded. Each iterator runs its own scan.
+public struct IndexStoreAsyncStream<Element>: AsyncSequence {
+    let configuration: IndexStoreStreamConfiguration
+    /// Passes each element to the given closure until it returns `false`.
+    let produce: ((Element) -> Bool) throws -> Void
+
+    init(configuration: IndexStoreStreamConfiguration, produce: @escaping ((Element) -> Bool) throws -> Void) {
+        self.configuration = configuration
+        self.produce = produce
+    }
+
+    public func makeAsyncIterator() -> Iterator {
+        let channel = StreamChannel<Element>(capacity: max(1, configuration.bufferedBatches))
+        let batchSize = max(1, configuration.batchSize)
+        let produce = self.produce
+        let thread = Thread {
+            var batch: [Element] = []
+            batch.reserveCapacity(batchSize)
+            var isConsumed = true
+            do {
+                try produce { element in
+                    batch.append(element)
+                    guard batch.count >= batchSize else { return true }
+                    isConsumed = channel.send(batch)
+                    batch.removeAll(keepingCapacity: true)
+                    return isConsumed
+                }
+                if isConsumed, !batch.isEmpty {
+                    _ = channel.send(batch)
+                }
+                channel.finish(throwing: nil)
+            } catch {
+                channel.finish(throwing: error)
+            }
+        }
+        thread.name = "SwiftIndexStore.IndexStoreAsyncStream"
+        thread.start()
+        return Iterator(consumer: StreamConsumer(channel: channel))
+    }
+
+    public struct Iterator: AsyncIteratorProtocol {
+        let consumer: StreamConsumer<Element>
+        private var batch: [Element] = []
+        private var index = 0
+
+        init(consumer: StreamConsumer<Element>) {
+            self.consumer = consumer
+        }
+
+        public mutating func next() async throws -> Element? {
+            if index == batch.count {
+                guard let next = try await consumer.channel.receive() else { return nil }
+                batch = next
+                index = 0
+            }
+            defer { index += 1 }
+            return batch[index]
+        }
+    }
+}
+
+/// Cancels the producer once the last copy of an iterator goes away.
+final class StreamConsumer<Element> {
+    let channel: StreamChannel<Element>
+
+    init(channel: StreamChannel<Element>) {
+        self.channel = channel
+    }
+
+    deinit {
+        channel.cancel()
+    }
+}
+
+/// A bounded queue of batches between a blocking producer thread and an
+/// async consumer.
+final class StreamChannel<Element>: @unchecked Sendable {
+    private let condition = NSCondition()
+    private let capacity: Int
+    private var batches: [[Element]] = []
+    private var isFinished = false
+    private var isCancelled = false
+    private var error: Error?
+    private var waiter: CheckedContinuation<[Element]?, Error>?
+
+    init(capacity: Int) {
+        self.capacity = capacity
+    }
+
+    /// Blocks while the buffer is full. Returns `false` once the consumer has
+    /// stopped iterating; `batch` is then dropped.
+    func send(_ batch: [Element]) -> Bool {
+        condition.lock()
+        while batches.count >= capacity, !isCancelled {
+            condition.wait()
+        }
+        if isCancelled {
+            condition.unlock()
+            return false
+        }
+        if let waiter {
+            self.waiter = nil
+            condition.unlock()
+            waiter.resume(returning: batch)
+            return true
+        }
+        batches.append(batch)
+        condition.unlock()
+        return true
+    }
+
+    func finish(throwing error: Error?) {
+        condition.lock()
+        isFinished = true
+        let waiter = self.waiter
+        self.waiter = nil
+        if waiter == nil {
+            self.error = error
+        }
+        condition.unlock()
+
+        if let error {
+            waiter?.resume(throwing: error)
+        } else {
+            waiter?.resume(returning: nil)
+        }
+    }
+
+    func cancel() {
+        condition.lock()
+        isCancelled = true
+        batches.removeAll()
+        let waiter = self.waiter
+        self.waiter = nil
+        condition.broadcast()
+        condition.unlock()
+        waiter?.resume(returning: nil)
+    }
+
+    /// Returns the next batch, or `nil` once the producer has finished or the
+    /// task was cancelled.
+    func receive() async throws -> [Element]? {
+        try await withTaskCancellationHandler {
+            try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<[Element]?, Error>) in
+                condition.lock()
+                if !batches.isEmpty {
+                    let batch = batches.removeFirst()
+                    condition.signal()
+                    condition.unlock()
+                    continuation.resume(returning: batch)
+                } else if isCancelled {
+                    condition.unlock()
+                    continuation.resume(returning: nil)
+                } else if isFinished {
+                    let error = self.error
+                    self.error = nil
+                    condition.unlock()
+                    if let error {
+                        continuation.resume(throwing: error)
+                    } else {
+                        continuation.resume(returning: nil)
+                    }
+                } else {
+                    waiter = continuation
+                    condition.unlock()
+                }
+            }
+        } onCancel: {
+            cancel()
+        }
+    }
+}
+
+extension IndexStore {
+
+    public func unitStream(
+        includeSystem: Bool = true,
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<IndexStoreUnit> {
+        IndexStoreAsyncStream(configuration: configuration) { yield in
+            self.forEachUnits(includeSystem: includeSystem, yield)
+        }
+    }
+
+    public func recordDependencyStream(
+        for unit: IndexStoreUnit,
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<IndexStoreUnit.Dependency> {
+        IndexStoreAsyncStream(configuration: configuration) { yield in
+            try self.forEachRecordDependencies(for: unit, yield)
+        }
+    }
+
+    public func occurrenceStream(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<IndexStoreOccurrence> {
+        IndexStoreAsyncStream(configuration: configuration) { yield in
+            try self.forEachOccurrences(for: record, matching: filter, yield)
+        }
+    }
+
+    /// Streams the matching occurrences of every distinct record in the store.
+    public func occurrenceStream(
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<(record: IndexStoreUnit.Dependency.Record, occurrence: IndexStoreOccurrence)> {
+        IndexStoreAsyncStream(configuration: configuration) { yield in
+            try self.forEachOccurrences(matching: filter) { yield(($0, $1)) }
+        }
+    }
+
+    /// Streams the matching occurrences of `record` with their relations.
+    ///
+    /// Relations can only be read while the record reader visits their
+    /// occurrence, so they are collected on the producer thread rather than
+    /// looked up from a streamed occurrence.
+    public func occurrenceStreamWithRelations(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<(occurrence: IndexStoreOccurrence, relations: [IndexStoreRelation])> {
+        IndexStoreAsyncStream(configuration: configuration) { yield in
+            try self.forEachOccurrences(for: record, matching: filter) { occurrence in
+                yield((occurrence, self.relations(for: occurrence)))
+            }
+        }
+    }
+}
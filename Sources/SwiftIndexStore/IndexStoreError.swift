@@ -8,6 +8,10 @@ enum IndexStoreError: LocalizedError {
     case missingSymbol(String)
     case unableGetErrorDescription
     case unableGetToolchainDirectory
+    case unableLoadLibrary(URL, String)
+    case invalidIndexFile(URL, String)
+    case socketError(String)
+    case invalidQueryMessage(String)
 
     var errorDescription: String? {
         switch self {
@@ -25,6 +29,14 @@ enum IndexStoreError: LocalizedError {
             return "Unable to get description for error"
         case .unableGetToolchainDirectory:
             return "Unable to get toolchain directory"
+        case .unableLoadLibrary(let path, let message):
+            return "Unable to load \(path.path): \(message)"
+        case .invalidIndexFile(let path, let reason):
+            return "Invalid index file at \(path.path): \(reason)"
+        case .socketError(let message):
+            return "Socket error: \(message)"
+        case .invalidQueryMessage(let reason):
+            return "Invalid query message: \(reason)"
         }
     }
 }
@@ -0,0 +1,198 @@
+import Foundation
+
+/// Several index stores scanned as one, e.g. the stores of the build
+/// configurations or output bases of the same sources.
+///
+/// Units and records are named after their content, so a unit or record found
+/// in more than one store is visited once, in the first store listing it.
+/// Scans share a single worker pool over the distinct records of all stores
+/// instead of walking the stores one after another.
+public final class IndexStoreFederation {
+
+    /// A value read from one of the federated stores.
+    public struct Member<Value> {
+        public let store: IndexStore
+        public let value: Value
+    }
+
+    public struct RecordEntry {
+        /// The first store listing the record, which scans read it from.
+        public var store: IndexStore
+        public var record: IndexStoreUnit.Dependency.Record
+        /// The units of every store depending on the record.
+        public var units: [Member<IndexStoreUnit>]
+    }
+
+    public let stores: [IndexStore]
+
+    public init(stores: [IndexStore]) {
+        self.stores = stores
+    }
+
+    /// Opens the stores at `paths`, skipping paths given more than once.
+    public static func open(
+        stores paths: [URL],
+        lib: LibIndexStore,
+        configuration: IndexStore.Configuration = .init()
+    ) throws -> IndexStoreFederation {
+        var seen = Set<String>()
+        let paths = paths.filter { seen.insert($0.standardizedFileURL.path).inserted }
+        return IndexStoreFederation(stores: try paths.map {
+            try IndexStore.open(store: $0, lib: lib, configuration: configuration)
+        })
+    }
+
+    /// The units of all stores, without units of the same name found in a
+    /// later store.
+    public func units(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [Member<IndexStoreUnit>] {
+        let perStore = try IndexStore.concurrentMap(stores, workerCount: workerCount) { store in
+            store.units(includeSystem: includeSystem).map { Member(store: store, value: $0) }
+        }
+        var seen = Set<String>()
+        return perStore.joined().filter { unit in
+            guard let name = unit.value.name else { return true }
+            return seen.insert(name).inserted
+        }
+    }
+
+    /// The distinct records of all stores, in the order a serial walk of the
+    /// stores and their units first sees them.
+    public func distinctRecords(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [RecordEntry] {
+        let units = try self.units(includeSystem: includeSystem, workerCount: workerCount)
+        let unitRecords = try IndexStore.concurrentMap(units, workerCount: workerCount) { unit in
+            try unit.store.recordDependencies(for: unit.value).compactMap(\.record)
+        }
+
+        var entries: [RecordEntry] = []
+        var entryIndices: [String: Int] = [:]
+        for (unit, records) in zip(units, unitRecords) {
+            for record in records {
+                guard let name = record.name else { continue }
+                if let index = entryIndices[name] {
+                    entries[index].units.append(unit)
+                } else {
+                    entryIndices[name] = entries.count
+                    entries.append(RecordEntry(store: unit.store, record: record, units: [unit]))
+                }
+            }
+        }
+        return entries
+    }
+
+    /// Applies `transform` to each distinct record of all stores on a single
+    /// pool of `workerCount` workers. Results are returned in
+    /// `distinctRecords()` order.
+    public func concurrentMapDistinctRecords<T>(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        _ transform: (RecordEntry) throws -> T
+    ) throws -> [T] {
+        let entries = try distinctRecords(includeSystem: includeSystem, workerCount: workerCount)
+        return try IndexStore.concurrentMap(entries, workerCount: workerCount, transform)
+    }
+
+    /// The records of the source file at `path` in every store, without
+    /// records of the same name found in a later store.
+    public func records(forPath path: String) throws -> [Member<IndexStoreUnit.Dependency.Record>] {
+        var seen = Set<String>()
+        return try stores.flatMap { store in
+            try store.records(forPath: path).map { Member(store: store, value: $0) }
+        }.filter { record in
+            guard let name = record.value.name else { return true }
+            return seen.insert(name).inserted
+        }
+    }
+
+    /// The occurrences of the symbol with this USR in all stores, found by one
+    /// concurrent scan of their distinct records.
+    ///
+    /// Records of the same file differing between stores often share most of
+    /// their occurrences, so an occurrence is reported once per location and
+    /// roles. Results are ordered by path, line and column.
+    public func occurrences(
+        ofUSR usr: String,
+        roles: IndexStoreOccurrence.Role? = nil,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [Member<IndexStoreOccurrence>] {
+        let filter = IndexStoreOccurrenceFilter(roles: roles, usrPrefixes: [usr], includeSystem: includeSystem)
+        let perRecord = try concurrentMapDistinctRecords(
+            includeSystem: includeSystem, workerCount: workerCount
+        ) { entry -> [Member<IndexStoreOccurrence>] in
+            var occurrences: [Member<IndexStoreOccurrence>] = []
+            try entry.store.forEachOccurrenceRefs(for: entry.record, matching: filter) { occurrence in
+                // The filter matches USR prefixes.
+                if occurrence.symbol.usr == usr {
+                    occurrences.append(Member(store: entry.store, value: occurrence.materialize()))
+                }
+                return true
+            }
+            return occurrences
+        }
+
+        var seen = Set<String>()
+        let occurrences = perRecord.joined().filter { seen.insert(Self.dedupKey(of: $0.value)).inserted }
+        return occurrences.sorted {
+            let lhs = $0.value.location
+            let rhs = $1.value.location
+            return (lhs.path ?? "", lhs.line, lhs.column) < (rhs.path ?? "", rhs.line, rhs.column)
+        }
+    }
+
+    /// Streams the occurrences of the symbol with this USR in all stores,
+    /// reported once per location and roles like `occurrences(ofUSR:)`.
+    ///
+    /// Occurrences come in `distinctRecords()` order, one record at a time,
+    /// instead of sorted, so a consumer stopping early skips the records left.
+    public func occurrenceStream(
+        ofUSR usr: String,
+        roles: IndexStoreOccurrence.Role? = nil,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        configuration: IndexStoreStreamConfiguration = .init()
+    ) -> IndexStoreAsyncStream<Member<IndexStoreOccurrence>> {
+        let filter = IndexStoreOccurrenceFilter(roles: roles, usrPrefixes: [usr], includeSystem: includeSystem)
+        return IndexStoreAsyncStream(configuration: configuration) { yield in
+            var seen = Set<String>()
+            var isConsumed = true
+            for entry in try self.distinctRecords(includeSystem: includeSystem, workerCount: workerCount) where isConsumed {
+                try entry.store.forEachOccurrenceRefs(for: entry.record, matching: filter) { occurrence in
+                    // The filter matches USR prefixes.
+                    guard occurrence.symbol.usr == usr else { return true }
+                    let materialized = occurrence.materialize()
+                    guard seen.insert(Self.dedupKey(of: materialized)).inserted else { return true }
+                    isConsumed = yield(Member(store: entry.store, value: materialized))
+                    return isConsumed
+                }
+            }
+        }
+    }
+
+    /// Occurrences of different records with the same key are reported once.
+    private static func dedupKey(of occurrence: IndexStoreOccurrence) -> String {
+        let location = occurrence.location
+        return "\(location.path ?? ""):\(location.line):\(location.column):\(occurrence.roles.rawValue)"
+    }
+
+    public func definitions(
+        ofUSR usr: String,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [Member<IndexStoreOccurrence>] {
+        try occurrences(ofUSR: usr, roles: .definition, includeSystem: includeSystem, workerCount: workerCount)
+    }
+
+    public func references(
+        ofUSR usr: String,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [Member<IndexStoreOccurrence>] {
+        try occurrences(ofUSR: usr, roles: .reference, includeSystem: includeSystem, workerCount: workerCount)
+    }
+}
@@ -0,0 +1,328 @@
+import _CIndexStore
+import Foundation
+
+/// Opt-in counters for libIndexStore calls, scans, readers and string
+/// materialization.
+///
+/// Instrumentation is process-wide. While it is stopped, every hook is a
+/// single load and branch on `active`. Start it before scanning, since hooks
+/// already running keep reporting to the instance they saw.
+public final class IndexStoreInstrumentation {
+
+    /// The scan loops of `IndexStore` which are timed.
+    public enum Scan: Int, CaseIterable {
+        case units
+        case recordDependencies
+        case symbols
+        case symbolRefs
+        case occurrences
+        case occurrenceRefs
+        case lineRangeOccurrences
+        case relations
+
+        public var name: String {
+            switch self {
+            case .units: return "units"
+            case .recordDependencies: return "recordDependencies"
+            case .symbols: return "symbols"
+            case .symbolRefs: return "symbolRefs"
+            case .occurrences: return "occurrences"
+            case .occurrenceRefs: return "occurrenceRefs"
+            case .lineRangeOccurrences: return "lineRangeOccurrences"
+            case .relations: return "relations"
+            }
+        }
+    }
+
+    public struct ScanStatistics: Equatable {
+        public var count: Int = 0
+        /// Elements passed to the callback.
+        public var elements: Int = 0
+        public var seconds: Double = 0
+        /// Time spent in the callback, out of `seconds`.
+        public var callbackSeconds: Double = 0
+
+        /// Time spent in libIndexStore and in building the values passed to
+        /// the callback.
+        public var librarySeconds: Double {
+            seconds - callbackSeconds
+        }
+    }
+
+    public struct Snapshot: Equatable {
+        /// Number of calls of each libIndexStore entry point, keyed by its
+        /// name without the `indexstore_` prefix.
+        public var calls: [String: Int] = [:]
+        public var scans: [Scan: ScanStatistics] = [:]
+        public var unitReadersCreated = 0
+        public var unitReadersDisposed = 0
+        public var recordReadersCreated = 0
+        public var recordReadersDisposed = 0
+        /// `IndexStoreSymbol` and `IndexStoreOccurrence` values built.
+        public var constructedValues = 0
+        /// Time spent building them, including the accessor calls it makes.
+        public var constructionSeconds: Double = 0
+        public var materializedStrings = 0
+        public var materializedStringBytes = 0
+        public var unitReaderCache: IndexStoreCacheStatistics?
+        public var recordReaderCache: IndexStoreCacheStatistics?
+    }
+
+    /// The running instrumentation, if any. Hooks read it with a single
+    /// atomic load.
+    @inline(__always)
+    static var active: IndexStoreInstrumentation? {
+        swiftindexstore_atomic_load_pointer(activeSlot).map {
+            Unmanaged<IndexStoreInstrumentation>.fromOpaque($0).takeUnretainedValue()
+        }
+    }
+
+    /// Holds an unretained reference to the running instance.
+    private static let activeSlot: UnsafeMutablePointer<UnsafeMutableRawPointer?> = {
+        let slot = UnsafeMutablePointer<UnsafeMutableRawPointer?>.allocate(capacity: 1)
+        slot.initialize(to: nil)
+        return slot
+    }()
+    private static let activeLock = UnfairLock()
+    /// Every instance ever started. Hooks may still hold one after it was
+    /// stopped, so instances are never released.
+    private static var instances: [IndexStoreInstrumentation] = []
+
+    /// Publishes `instrumentation` as the running instance. Called with
+    /// `activeLock` held.
+    private static func setActive(_ instrumentation: IndexStoreInstrumentation?) {
+        if let instrumentation {
+            instances.append(instrumentation)
+        }
+        swiftindexstore_atomic_store_pointer(activeSlot, instrumentation.map { Unmanaged.passUnretained($0).toOpaque() })
+    }
+
+    public static var isEnabled: Bool {
+        active != nil
+    }
+
+    /// Starts collecting with zeroed counters, replacing any running
+    /// instrumentation.
+    public static func start() {
+        activeLock.perform {
+            setActive(IndexStoreInstrumentation())
+        }
+    }
+
+    /// Stops collecting and returns what was collected, or `nil` if
+    /// instrumentation was not running.
+    @discardableResult
+    public static func stop(store: IndexStore? = nil) -> Snapshot? {
+        let instrumentation: IndexStoreInstrumentation? = activeLock.perform {
+            defer { setActive(nil) }
+            return active
+        }
+        return instrumentation?.snapshot(store: store)
+    }
+
+    /// The counters collected so far, with the reader cache statistics of
+    /// `store` when given.
+    public static func snapshot(store: IndexStore? = nil) -> Snapshot? {
+        activeLock.perform { active }?.snapshot(store: store)
+    }
+
+    private struct Call {
+        var name: String
+        var count: Int
+    }
+
+    /// Counters are split by thread, so that concurrent scans rarely contend.
+    private final class Shard {
+        let lock = UnfairLock()
+        var calls: [AnyKeyPath: Call] = [:]
+        var scans = [ScanStatistics](repeating: .init(), count: Scan.allCases.count)
+        var unitReadersCreated = 0
+        var unitReadersDisposed = 0
+        var recordReadersCreated = 0
+        var recordReadersDisposed = 0
+        var constructedValues = 0
+        var constructionNanoseconds: UInt64 = 0
+        var materializedStrings = 0
+        var materializedStringBytes = 0
+    }
+
+    private let shards = (0..<16).map { _ in Shard() }
+
+    private init() {}
+
+    private var currentShard: Shard {
+        #if canImport(Darwin)
+        let thread = UInt64(UInt(bitPattern: pthread_self()))
+        #else
+        let thread = UInt64(pthread_self())
+        #endif
+        // Thread identifiers are aligned addresses, so mix their upper bits.
+        return shards[Int(((thread >> 6) &* 0x9E37_79B9_7F4A_7C15) >> 60)]
+    }
+
+    static func now() -> UInt64 {
+        DispatchTime.now().uptimeNanoseconds
+    }
+
+    func recordCall<T>(_ keyPath: KeyPath<indexstore_functions_t, T>, lib: LibIndexStore) {
+        let shard = currentShard
+        shard.lock.perform {
+            if shard.calls[keyPath] != nil {
+                shard.calls[keyPath]!.count += 1
+            } else {
+                let name = MemoryLayout<indexstore_functions_t>.offset(of: keyPath).flatMap { lib.functionName(at: $0) }
+                shard.calls[keyPath] = Call(name: name ?? "\(keyPath)", count: 1)
+            }
+        }
+    }
+
+    func recordReader(unit: Bool, created: Bool) {
+        let shard = currentShard
+        shard.lock.perform {
+            switch (unit, created) {
+            case (true, true): shard.unitReadersCreated += 1
+            case (true, false): shard.unitReadersDisposed += 1
+            case (false, true): shard.recordReadersCreated += 1
+            case (false, false): shard.recordReadersDisposed += 1
+            }
+        }
+    }
+
+    func recordString(bytes: Int) {
+        let shard = currentShard
+        shard.lock.perform {
+            shard.materializedStrings += 1
+            shard.materializedStringBytes += bytes
+        }
+    }
+
+    private func recordConstruction(nanoseconds: UInt64) {
+        let shard = currentShard
+        shard.lock.perform {
+            shard.constructedValues += 1
+            shard.constructionNanoseconds += nanoseconds
+        }
+    }
+
+    private func recordScan(_ scan: Scan, elements: Int, nanoseconds: UInt64, callbackNanoseconds: UInt64) {
+        let shard = currentShard
+        shard.lock.perform {
+            shard.scans[scan.rawValue].count += 1
+            shard.scans[scan.rawValue].elements += elements
+            shard.scans[scan.rawValue].seconds += Double(nanoseconds) / 1e9
+            shard.scans[scan.rawValue].callbackSeconds += Double(callbackNanoseconds) / 1e9
+        }
+    }
+
+    /// Times a value construction of a materializing scan.
+    @inline(__always)
+    static func measureConstruction<T>(_ body: () -> T) -> T {
+        guard let instrumentation = active else {
+            return body()
+        }
+        let start = now()
+        let value = body()
+        instrumentation.recordConstruction(nanoseconds: now() - start)
+        return value
+    }
+
+    /// Runs the scan loop `body` with `next`, timing the whole loop and the
+    /// calls of `next` separately.
+    @inline(__always)
+    static func measure<Element>(
+        _ scan: Scan,
+        _ next: (Element) throws -> Bool,
+        _ body: ((Element) throws -> Bool) throws -> Void
+    ) rethrows {
+        guard let instrumentation = active else {
+            return try body(next)
+        }
+        var elements = 0
+        var callbackNanoseconds: UInt64 = 0
+        let start = now()
+        defer {
+            instrumentation.recordScan(
+                scan, elements: elements,
+                nanoseconds: now() - start,
+                callbackNanoseconds: callbackNanoseconds
+            )
+        }
+        try body { element in
+            let callbackStart = now()
+            defer {
+                elements += 1
+                callbackNanoseconds += now() - callbackStart
+            }
+            return try next(element)
+        }
+    }
+
+    private func snapshot(store: IndexStore?) -> Snapshot {
+        var snapshot = Snapshot()
+        var constructionNanoseconds: UInt64 = 0
+        for shard in shards {
+            shard.lock.perform {
+                for call in shard.calls.values {
+                    snapshot.calls[call.name, default: 0] += call.count
+                }
+                for scan in Scan.allCases where shard.scans[scan.rawValue].count > 0 {
+                    let statistics = shard.scans[scan.rawValue]
+                    snapshot.scans[scan, default: .init()].count += statistics.count
+                    snapshot.scans[scan, default: .init()].elements += statistics.elements
+                    snapshot.scans[scan, default: .init()].seconds += statistics.seconds
+                    snapshot.scans[scan, default: .init()].callbackSeconds += statistics.callbackSeconds
+                }
+                snapshot.unitReadersCreated += shard.unitReadersCreated
+                snapshot.unitReadersDisposed += shard.unitReadersDisposed
+                snapshot.recordReadersCreated += shard.recordReadersCreated
+                snapshot.recordReadersDisposed += shard.recordReadersDisposed
+                snapshot.constructedValues += shard.constructedValues
+                constructionNanoseconds += shard.constructionNanoseconds
+                snapshot.materializedStrings += shard.materializedStrings
+                snapshot.materializedStringBytes += shard.materializedStringBytes
+            }
+        }
+        snapshot.constructionSeconds = Double(constructionNanoseconds) / 1e9
+        snapshot.unitReaderCache = store?.unitReaderCacheStatistics
+        snapshot.recordReaderCache = store?.recordReaderCacheStatistics
+        return snapshot
+    }
+}
+
+extension IndexStoreInstrumentation.Snapshot: CustomStringConvertible {
+    public var description: String {
+        func seconds(_ value: Double) -> String {
+            String(format: "%.6fs", value)
+        }
+        func cache(_ statistics: IndexStoreCacheStatistics) -> String {
+            "\(statistics.hits) hits, \(statistics.misses) misses, \(statistics.evictions) evictions, "
+                + String(format: "%.1f%% hit rate", statistics.hitRate * 100)
+        }
+
+        var lines: [String] = []
+        lines.append("calls:")
+        for (name, count) in calls.sorted(by: { ($1.value, $0.key) < ($0.value, $1.key) }) {
+            lines.append("  \(name): \(count)")
+        }
+        lines.append("scans:")
+        for scan in IndexStoreInstrumentation.Scan.allCases {
+            guard let statistics = scans[scan] else { continue }
+            lines.append(
+                "  \(scan.name): \(statistics.count) scans, \(statistics.elements) elements, "
+                    + "\(seconds(statistics.seconds)) total, \(seconds(statistics.librarySeconds)) library, "
+                    + "\(seconds(statistics.callbackSeconds)) callback"
+            )
+        }
+        lines.append("construction: \(constructedValues) values, \(seconds(constructionSeconds))")
+        lines.append("unit readers: \(unitReadersCreated) created, \(unitReadersDisposed) disposed")
+        lines.append("record readers: \(recordReadersCreated) created, \(recordReadersDisposed) disposed")
+        lines.append("strings: \(materializedStrings) materialized, \(materializedStringBytes) bytes")
+        if let unitReaderCache {
+            lines.append("unit reader cache: \(cache(unitReaderCache))")
+        }
+        if let recordReaderCache {
+            lines.append("record reader cache: \(cache(recordReaderCache))")
+        }
+        return lines.joined(separator: "\n")
+    }
+}
@@ -0,0 +1,172 @@
+import Foundation
+
+public struct IndexStoreModificationTime: Hashable, Codable {
+    public var seconds: Int64
+    public var nanoseconds: Int64
+
+    public init(seconds: Int64, nanoseconds: Int64) {
+        self.seconds = seconds
+        self.nanoseconds = nanoseconds
+    }
+
+    public var date: Date {
+        Date(timeIntervalSince1970: TimeInterval(seconds) + TimeInterval(nanoseconds) / 1_000_000_000)
+    }
+}
+
+/// A snapshot of the units of a store, persisted between runs to find out
+/// which units changed without opening their readers.
+public struct IndexStoreManifest: Codable, Equatable {
+    public struct Unit: Codable, Equatable {
+        public var modificationTime: IndexStoreModificationTime
+        public var isSystem: Bool
+        /// Names of the records the unit depends on.
+        public var records: [String]
+
+        public init(modificationTime: IndexStoreModificationTime, isSystem: Bool, records: [String]) {
+            self.modificationTime = modificationTime
+            self.isSystem = isSystem
+            self.records = records
+        }
+    }
+
+    static let currentVersion = 1
+
+    var version: Int
+    /// The libIndexStore format version of the store the manifest describes.
+    public var formatVersion: Int
+    /// Keyed by unit name.
+    public var units: [String: Unit]
+
+    public init(formatVersion: Int, units: [String: Unit]) {
+        self.version = Self.currentVersion
+        self.formatVersion = formatVersion
+        self.units = units
+    }
+
+    /// Returns `nil` if there is no manifest at `url` or it was written by an
+    /// incompatible version of this library.
+    public static func load(from url: URL) throws -> IndexStoreManifest? {
+        guard FileManager.default.fileExists(atPath: url.path) else { return nil }
+        let manifest = try JSONDecoder().decode(IndexStoreManifest.self, from: Data(contentsOf: url))
+        guard manifest.version == currentVersion else { return nil }
+        return manifest
+    }
+
+    public func write(to url: URL) throws {
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = .sortedKeys
+        try encoder.encode(self).write(to: url, options: .atomic)
+    }
+}
+
+/// The difference between a store and a previously taken manifest.
+public struct IndexStoreChangeSet {
+    public var added: [IndexStoreUnit]
+    public var modified: [IndexStoreUnit]
+    public var removed: [IndexStoreUnit]
+    public var unchangedCount: Int
+    /// Records that no unit of the previous manifest depended on.
+    public var addedRecords: Set<String>
+    /// Records that no unit depends on anymore.
+    public var removedRecords: Set<String>
+    /// The manifest describing the store as scanned. Persist it once the
+    /// changes have been processed.
+    public var manifest: IndexStoreManifest
+
+    public var changedUnits: [IndexStoreUnit] {
+        added + modified
+    }
+
+    public var isEmpty: Bool {
+        added.isEmpty && modified.isEmpty && removed.isEmpty
+    }
+}
+
+extension IndexStore {
+
+    public func modificationTime(for unit: IndexStoreUnit) throws -> IndexStoreModificationTime {
+        var seconds: Int64 = 0
+        var nanoseconds: Int64 = 0
+        let failed = try lib.throwsfy({
+            lib.store_get_unit_modification_time(store, unit.name, &seconds, &nanoseconds, &$0)
+        })
+        if failed {
+            throw IndexStoreError.internalError("Unable to get modification time of unit \(unit.name ?? "nil")")
+        }
+        return IndexStoreModificationTime(seconds: seconds, nanoseconds: nanoseconds)
+    }
+
+    /// Compares the store against `previous` and returns what changed.
+    ///
+    /// Only units whose modification time differs from the one recorded in
+    /// `previous` are opened, with fresh readers rather than ones this store
+    /// cached before the unit was rewritten. Passing `nil`, or a manifest of
+    /// a different store format, reports every unit as added.
+    public func scanChanges(
+        since previous: IndexStoreManifest?,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> IndexStoreChangeSet {
+        let formatVersion = Int(lib.format_version())
+        let previousUnits = previous?.formatVersion == formatVersion ? previous?.units ?? [:] : [:]
+
+        let current = try concurrentMap(units(), workerCount: workerCount) { unit -> (String, IndexStoreManifest.Unit)? in
+            guard let name = unit.name,
+                  // A unit removed since it was listed is treated as removed.
+                  let modificationTime = try? self.modificationTime(for: unit)
+            else { return nil }
+            if let entry = previousUnits[name], entry.modificationTime == modificationTime {
+                return (name, entry)
+            }
+            // The unit file may have been rewritten since this store last read it.
+            invalidateUnitReaders(for: [unit])
+            let records = try recordDependencies(for: unit).compactMap(\.record?.name)
+            let entry = IndexStoreManifest.Unit(
+                modificationTime: modificationTime,
+                isSystem: try isSystemUnit(unit),
+                records: records
+            )
+            return (name, entry)
+        }
+
+        var scannedUnits: [String: IndexStoreManifest.Unit] = [:]
+        scannedUnits.reserveCapacity(current.count)
+        var changeSet = IndexStoreChangeSet(
+            added: [], modified: [], removed: [], unchangedCount: 0,
+            addedRecords: [], removedRecords: [],
+            manifest: IndexStoreManifest(formatVersion: formatVersion, units: [:])
+        )
+        for case let (name, entry)? in current {
+            scannedUnits[name] = entry
+            guard includeSystem || !entry.isSystem else { continue }
+            switch previousUnits[name] {
+            case nil:
+                changeSet.added.append(IndexStoreUnit(name: name))
+            case let previousEntry? where previousEntry.modificationTime != entry.modificationTime:
+                changeSet.modified.append(IndexStoreUnit(name: name))
+            default:
+                changeSet.unchangedCount += 1
+            }
+        }
+        for (name, entry) in previousUnits where scannedUnits[name] == nil {
+            guard includeSystem || !entry.isSystem else { continue }
+            changeSet.removed.append(IndexStoreUnit(name: name))
+        }
+
+        func recordNames(_ units: [String: IndexStoreManifest.Unit]) -> Set<String> {
+            var names = Set<String>()
+            for entry in units.values where includeSystem || !entry.isSystem {
+                names.formUnion(entry.records)
+            }
+            return names
+        }
+        let previousRecords = recordNames(previousUnits)
+        let currentRecords = recordNames(scannedUnits)
+        changeSet.addedRecords = currentRecords.subtracting(previousRecords)
+        changeSet.removedRecords = previousRecords.subtracting(currentRecords)
+
+        changeSet.manifest.units = scannedUnits
+        return changeSet
+    }
+}
@@ -61,6 +61,11 @@ public struct IndexStoreOccurrence {
             (.specializationOf, "specializationOf")
         ]
 
+        /// Names of the roles in the set, such as `definition`.
+        public var names: [String] {
+            dumpOptions()
+        }
+
         public var description: String {
             "Roles(\(dumpOptions()))"
         }
@@ -77,6 +82,8 @@ public struct IndexStoreOccurrence {
     public var symbol: IndexStoreSymbol
     public var location: Location
 
+    /// Only valid during the scan callback that produced the occurrence, so
+    /// relations must be read from within that callback.
     let anchor: indexstore_occurrence_t?
 
 }
@@ -0,0 +1,125 @@
+import Foundation
+
+/// The occurrences of one record in struct-of-arrays form.
+///
+/// Symbols and paths are stored as indices into the `IndexStoreColumnarTables`
+/// the batch was filled with, so an occurrence takes 20 bytes.
+public struct IndexStoreOccurrenceBatch {
+    /// Index of the record path in `IndexStoreColumnarTables.paths`.
+    public internal(set) var path: UInt32 = 0
+    public internal(set) var roles: [UInt64] = []
+    public internal(set) var lines: [UInt32] = []
+    public internal(set) var columns: [UInt32] = []
+    /// Indices into `IndexStoreColumnarTables.symbols`.
+    public internal(set) var symbols: [UInt32] = []
+
+    public init() {}
+
+    public var count: Int {
+        roles.count
+    }
+
+    public var isEmpty: Bool {
+        roles.isEmpty
+    }
+
+    /// Empties the columns, keeping their storage for the next record.
+    public mutating func removeAll() {
+        roles.removeAll(keepingCapacity: true)
+        lines.removeAll(keepingCapacity: true)
+        columns.removeAll(keepingCapacity: true)
+        symbols.removeAll(keepingCapacity: true)
+    }
+
+    mutating func append(roles: UInt64, line: UInt32, column: UInt32, symbol: UInt32) {
+        self.roles.append(roles)
+        self.lines.append(line)
+        self.columns.append(column)
+        self.symbols.append(symbol)
+    }
+}
+
+/// Interned symbols and paths shared by the batches of a scan. Not
+/// thread-safe, but `strings` may be shared with other scans.
+public final class IndexStoreColumnarTables {
+    public let strings: IndexStoreStringInterner
+    public private(set) var symbols: [IndexStoreInternedSymbol] = []
+    public private(set) var paths: [String?] = []
+    private var symbolIndices: [IndexStoreStringInterner.ID: UInt32] = [:]
+    private var pathIndices: [String?: UInt32] = [:]
+
+    public init(strings: IndexStoreStringInterner = .init()) {
+        self.strings = strings
+    }
+
+    func intern(_ symbol: IndexStoreSymbolRef) -> UInt32 {
+        let usr = strings.intern(symbol.usr)
+        if let index = symbolIndices[usr] {
+            return index
+        }
+        let index = UInt32(symbols.count)
+        symbols.append(IndexStoreInternedSymbol(
+            usr: usr,
+            name: strings.intern(symbol.name),
+            kind: symbol.kind,
+            subKind: symbol.subKind,
+            language: symbol.language
+        ))
+        symbolIndices[usr] = index
+        return index
+    }
+
+    func intern(path: String?) -> UInt32 {
+        if let index = pathIndices[path] {
+            return index
+        }
+        let index = UInt32(paths.count)
+        paths.append(path)
+        pathIndices[path] = index
+        return index
+    }
+}
+
+extension IndexStore {
+
+    /// Replaces the contents of `batch` with the matching occurrences of
+    /// `record`, reusing its storage.
+    public func fillOccurrenceBatch(
+        _ batch: inout IndexStoreOccurrenceBatch,
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        tables: IndexStoreColumnarTables
+    ) throws {
+        batch.removeAll()
+        batch.path = tables.intern(path: record.filePath)
+        try forEachOccurrenceRefs(for: record, matching: filter) { occurrence in
+            let index = tables.intern(occurrence.symbol)
+            let location = occurrence.lineAndColumn
+            batch.append(
+                roles: occurrence.roles.rawValue,
+                line: UInt32(truncatingIfNeeded: location.line),
+                column: UInt32(truncatingIfNeeded: location.column),
+                symbol: index
+            )
+            return true
+        }
+    }
+
+    /// Visits the matching occurrences of every distinct record, one batch per
+    /// record.
+    ///
+    /// The same batch storage is refilled for each record; copy the batch to
+    /// keep it beyond the call to `next`.
+    public func forEachOccurrenceBatches(
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        tables: IndexStoreColumnarTables,
+        _ next: (IndexStoreOccurrenceBatch) throws -> Bool
+    ) throws {
+        var batch = IndexStoreOccurrenceBatch()
+        try forEachDistinctRecords(includeSystem: filter.includeSystem) { entry in
+            try fillOccurrenceBatch(&batch, for: entry.record, matching: filter, tables: tables)
+            guard !batch.isEmpty else { return true }
+            return try next(batch)
+        }
+    }
+}
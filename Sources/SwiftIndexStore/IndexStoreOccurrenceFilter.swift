@@ -0,0 +1,222 @@
+import _CIndexStore
+
+/// Describes which occurrences a scan is interested in.
+///
+/// Predicates are evaluated on raw libIndexStore data before anything is
+/// materialized: system units are skipped before their records are opened,
+/// symbol predicates narrow the scan to the matching symbols of a record, and
+/// roles are checked before an occurrence is handed to Swift. `nil` predicates
+/// match everything.
+public struct IndexStoreOccurrenceFilter {
+    /// Matches occurrences having at least one of these roles.
+    public var roles: IndexStoreOccurrence.Role?
+    public var kinds: Set<IndexStoreSymbol.Kind>?
+    public var subKinds: Set<IndexStoreSymbol.SubKind>?
+    public var languages: Set<IndexStoreSymbol.Language>?
+    /// Matches symbols whose USR starts with any of these prefixes.
+    public var usrPrefixes: [String]?
+    public var includeSystem: Bool
+
+    public init(
+        roles: IndexStoreOccurrence.Role? = nil,
+        kinds: Set<IndexStoreSymbol.Kind>? = nil,
+        subKinds: Set<IndexStoreSymbol.SubKind>? = nil,
+        languages: Set<IndexStoreSymbol.Language>? = nil,
+        usrPrefixes: [String]? = nil,
+        includeSystem: Bool = true
+    ) {
+        self.roles = roles
+        self.kinds = kinds
+        self.subKinds = subKinds
+        self.languages = languages
+        self.usrPrefixes = usrPrefixes
+        self.includeSystem = includeSystem
+    }
+}
+
+/// `IndexStoreOccurrenceFilter` lowered to raw values for matching in C callbacks.
+struct CompiledOccurrenceFilter {
+    let roles: UInt64
+    let kinds: Set<UInt32>?
+    let subKinds: Set<UInt32>?
+    let languages: Set<UInt32>?
+    let usrPrefixes: [[UInt8]]?
+
+    init(_ filter: IndexStoreOccurrenceFilter) {
+        self.roles = filter.roles?.rawValue ?? 0
+        self.kinds = filter.kinds.map { Set($0.map(\.rawValue)) }
+        self.subKinds = filter.subKinds.map { Set($0.map(\.rawValue)) }
+        self.languages = filter.languages.map { Set($0.map(\.rawValue)) }
+        self.usrPrefixes = filter.usrPrefixes.map { $0.map { Array($0.utf8) } }
+    }
+
+    var hasSymbolPredicates: Bool {
+        roles != 0 || kinds != nil || subKinds != nil || languages != nil || usrPrefixes != nil
+    }
+
+    func matches(occurrenceRoles: UInt64) -> Bool {
+        roles == 0 || occurrenceRoles & roles != 0
+    }
+
+    func matches(symbol: indexstore_symbol_t?, lib: LibIndexStore) -> Bool {
+        // A symbol's roles are the union of the roles of its occurrences in the record.
+        if roles != 0, lib.symbol_get_roles(symbol) & roles == 0 {
+            return false
+        }
+        if let kinds, !kinds.contains(lib.symbol_get_kind(symbol).rawValue) {
+            return false
+        }
+        if let subKinds, !subKinds.contains(lib.symbol_get_subkind(symbol).rawValue) {
+            return false
+        }
+        if let languages, !languages.contains(lib.symbol_get_language(symbol).rawValue) {
+            return false
+        }
+        if let usrPrefixes {
+            let usr = lib.symbol_get_usr(symbol).bytes
+            return usrPrefixes.contains { prefix in
+                prefix.count <= usr.count && memcmpEqual(usr.baseAddress, prefix, prefix.count)
+            }
+        }
+        return true
+    }
+}
+
+extension IndexStore {
+
+    public func forEachSymbols(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter,
+        _ next: (IndexStoreSymbol) throws -> Bool
+    ) throws {
+        guard filter.includeSystem || !record.isSystem else { return }
+        let compiled = CompiledOccurrenceFilter(filter)
+        try withRecordReader(for: record) { reader in
+            for symbol in try searchSymbols(in: reader, matching: compiled) {
+                let sym = IndexStore.createSymbol(from: symbol, owner: reader, lib: lib)
+                guard try next(sym) else { break }
+            }
+        }
+    }
+
+    public func forEachOccurrences(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter,
+        _ next: (IndexStoreOccurrence) throws -> Bool
+    ) throws {
+        guard filter.includeSystem || !record.isSystem else { return }
+        let compiled = CompiledOccurrenceFilter(filter)
+        try withRecordReader(for: record) { reader in
+            try applyOccurrences(in: reader, matching: compiled) { occurrence in
+                let occ = IndexStore.createOccurrence(
+                    from: occurrence,
+                    recordPath: record.filePath,
+                    isSystem: record.isSystem,
+                    language: nil,
+                    owner: reader,
+                    lib: lib
+                )!
+                return try next(occ)
+            }
+        }
+    }
+
+    public func forEachOccurrenceRefs(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter,
+        _ next: (IndexStoreOccurrenceRef) throws -> Bool
+    ) throws {
+        guard filter.includeSystem || !record.isSystem else { return }
+        let compiled = CompiledOccurrenceFilter(filter)
+        try withRecordReader(for: record) { reader in
+            let scan = RecordScan(lib: lib, reader: reader, record: record)
+            try withExtendedLifetime(scan) {
+                try applyOccurrences(in: reader, matching: compiled) { occurrence in
+                    try next(IndexStoreOccurrenceRef(occurrence: occurrence, scan: scan))
+                }
+            }
+        }
+    }
+
+    /// Visits the matching occurrences of every distinct record in the store.
+    public func forEachOccurrences(
+        matching filter: IndexStoreOccurrenceFilter,
+        _ next: (IndexStoreUnit.Dependency.Record, IndexStoreOccurrence) throws -> Bool
+    ) throws {
+        try forEachDistinctRecords(includeSystem: filter.includeSystem) { entry in
+            var shouldContinue = true
+            try forEachOccurrences(for: entry.record, matching: filter) { occ in
+                shouldContinue = try next(entry.record, occ)
+                return shouldContinue
+            }
+            return shouldContinue
+        }
+    }
+
+    // - MARK: Private
+
+    func searchSymbols(in reader: RecordReader, matching filter: CompiledOccurrenceFilter) throws -> [indexstore_symbol_t?] {
+        try lib.bind(.symbolSearch)
+        typealias Search = (filter: CompiledOccurrenceFilter, lib: LibIndexStore, symbols: [indexstore_symbol_t?])
+        var search: Search = (filter, lib, [])
+        withUnsafeMutablePointer(to: &search) { search in
+            _ = lib.record_reader_search_symbols_f(
+                reader.reader,
+                search,
+                { ctx, symbol, _ -> Bool in
+                    let search = ctx!.assumingMemoryBound(to: Search.self)
+                    return search.pointee.filter.matches(symbol: symbol, lib: search.pointee.lib)
+                },
+                search,
+                { ctx, symbol in
+                    let search = ctx!.assumingMemoryBound(to: Search.self)
+                    search.pointee.symbols.append(symbol)
+                }
+            )
+        }
+        return search.symbols
+    }
+
+    /// Calls `body` with each raw occurrence of the record that passes `filter`.
+    func applyOccurrences(
+        in reader: RecordReader,
+        matching filter: CompiledOccurrenceFilter,
+        _ body: (indexstore_occurrence_t?) throws -> Bool
+    ) throws {
+        var symbols: [indexstore_symbol_t?] = []
+        if filter.hasSymbolPredicates {
+            symbols = try searchSymbols(in: reader, matching: filter)
+            guard !symbols.isEmpty else { return }
+        }
+
+        typealias Ctx = Context<(next: (indexstore_occurrence_t?) throws -> Bool, filter: CompiledOccurrenceFilter)>
+        try withoutActuallyEscaping(body) { body in
+            let handler = Ctx((body, filter), lib: lib)
+            let ctx = Unmanaged.passUnretained(handler).toOpaque()
+            let applier: @convention(c) (UnsafeMutableRawPointer?, indexstore_occurrence_t?) -> Bool = { ctx, occurrence in
+                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                guard ctx.content.filter.matches(occurrenceRoles: ctx.lib.occurrence_get_roles(occurrence)) else {
+                    return true
+                }
+                do { return try ctx.content.next(occurrence) } catch {
+                    ctx.error = error
+                    return false
+                }
+            }
+            if symbols.isEmpty {
+                _ = lib.record_reader_occurrences_apply_f(reader.reader, ctx, applier)
+            } else {
+                _ = symbols.withUnsafeMutableBufferPointer { symbols in
+                    lib.record_reader_occurrences_of_symbols_apply_f(
+                        reader.reader, symbols.baseAddress, symbols.count,
+                        nil, 0,
+                        ctx, applier
+                    )
+                }
+            }
+            if let error = handler.error {
+                throw error
+            }
+        }
+    }
+}
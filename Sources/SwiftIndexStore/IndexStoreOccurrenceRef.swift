@@ -0,0 +1,175 @@
+import _CIndexStore
+
+/// State shared by the borrowed cursors of a single record scan.
+final class RecordScan {
+    let lib: LibIndexStore
+    let reader: RecordReader
+    let recordPath: String?
+    let isSystem: Bool
+
+    init(lib: LibIndexStore, reader: RecordReader, record: IndexStoreUnit.Dependency.Record) {
+        self.lib = lib
+        self.reader = reader
+        self.recordPath = record.filePath
+        self.isSystem = record.isSystem
+    }
+}
+
+/// A borrowed view of a symbol that reads fields from libIndexStore on demand.
+///
+/// Only valid during the callback it was passed to. Use `materialize()` to
+/// get an `IndexStoreSymbol` that can be kept.
+public struct IndexStoreSymbolRef {
+    let symbol: indexstore_symbol_t?
+    unowned(unsafe) let scan: RecordScan
+
+    public var kind: IndexStoreSymbol.Kind {
+        IndexStoreSymbol.Kind(rawValue: scan.lib.symbol_get_kind(symbol).rawValue)!
+    }
+
+    public var subKind: IndexStoreSymbol.SubKind {
+        IndexStoreSymbol.SubKind(rawValue: scan.lib.symbol_get_subkind(symbol).rawValue)!
+    }
+
+    public var language: IndexStoreSymbol.Language {
+        IndexStoreSymbol.Language(rawValue: scan.lib.symbol_get_language(symbol).rawValue)!
+    }
+
+    public var usr: IndexStoreStringRef {
+        IndexStoreStringRef(scan.lib.symbol_get_usr(symbol))
+    }
+
+    public var name: IndexStoreStringRef {
+        IndexStoreStringRef(scan.lib.symbol_get_name(symbol))
+    }
+
+    public func materialize() -> IndexStoreSymbol {
+        IndexStore.createSymbol(from: symbol, owner: scan.reader, lib: scan.lib)
+    }
+}
+
+/// A borrowed view of an occurrence that reads fields from libIndexStore on demand.
+///
+/// Only valid during the callback it was passed to. Use `materialize()` to
+/// get an `IndexStoreOccurrence` that can be kept.
+public struct IndexStoreOccurrenceRef {
+    let occurrence: indexstore_occurrence_t?
+    unowned(unsafe) let scan: RecordScan
+
+    public var roles: IndexStoreOccurrence.Role {
+        IndexStoreOccurrence.Role(rawValue: scan.lib.occurrence_get_roles(occurrence))
+    }
+
+    public var symbol: IndexStoreSymbolRef {
+        IndexStoreSymbolRef(symbol: scan.lib.occurrence_get_symbol(occurrence), scan: scan)
+    }
+
+    public var lineAndColumn: (line: Int64, column: Int64) {
+        var line: UInt32 = 0
+        var column: UInt32 = 0
+        scan.lib.occurrence_get_line_col(occurrence, &line, &column)
+        return (Int64(line), Int64(column))
+    }
+
+    public var line: Int64 {
+        lineAndColumn.line
+    }
+
+    public var column: Int64 {
+        lineAndColumn.column
+    }
+
+    public func forEachRelation(_ next: (IndexStoreOccurrence.Role, IndexStoreSymbolRef) throws -> Bool) rethrows {
+        typealias Walk = (next: (IndexStoreOccurrence.Role, IndexStoreSymbolRef) throws -> Bool, scan: RecordScan, error: Error?)
+        try withoutActuallyEscaping(next) { next in
+            var walk: Walk = (next, scan, nil)
+            withUnsafeMutablePointer(to: &walk) { walk in
+                _ = scan.lib.occurrence_relations_apply_f(occurrence, walk) { ctx, relation -> Bool in
+                    let walk = ctx!.assumingMemoryBound(to: Walk.self)
+                    let lib = walk.pointee.scan.lib
+                    let roles = IndexStoreOccurrence.Role(rawValue: lib.symbol_relation_get_roles(relation))
+                    let symbol = IndexStoreSymbolRef(symbol: lib.symbol_relation_get_symbol(relation), scan: walk.pointee.scan)
+                    do { return try walk.pointee.next(roles, symbol) } catch {
+                        walk.pointee.error = error
+                        return false
+                    }
+                }
+            }
+            if let error = walk.error {
+                throw error
+            }
+        }
+    }
+
+    public func materialize() -> IndexStoreOccurrence {
+        IndexStore.createOccurrence(
+            from: occurrence,
+            recordPath: scan.recordPath,
+            isSystem: scan.isSystem,
+            language: nil,
+            owner: scan.reader,
+            lib: scan.lib
+        )!
+    }
+}
+
+extension IndexStore {
+
+    /// Visits the occurrences of `record` as borrowed cursors, without building
+    /// `IndexStoreOccurrence` values.
+    public func forEachOccurrenceRefs(
+        for record: IndexStoreUnit.Dependency.Record,
+        _ next: (IndexStoreOccurrenceRef) throws -> Bool
+    ) throws {
+        try IndexStoreInstrumentation.measure(.occurrenceRefs, next) { next in
+            typealias Ctx = Context<(next: (IndexStoreOccurrenceRef) throws -> Bool, scan: RecordScan)>
+            try withRecordReader(for: record) { reader in
+                let scan = RecordScan(lib: lib, reader: reader, record: record)
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, scan), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.record_reader_occurrences_apply_f(reader.reader, ctx) { ctx, occurrence -> Bool in
+                        let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                        let occ = IndexStoreOccurrenceRef(occurrence: occurrence, scan: ctx.content.scan)
+                        do { return try ctx.content.next(occ) } catch {
+                            ctx.error = error
+                            return false
+                        }
+                    }
+                    if let error = handler.error {
+                        throw error
+                    }
+                }
+            }
+        }
+    }
+
+    /// Visits the symbols of `record` as borrowed cursors, without building
+    /// `IndexStoreSymbol` values.
+    public func forEachSymbolRefs(
+        for record: IndexStoreUnit.Dependency.Record,
+        _ next: (IndexStoreSymbolRef) throws -> Bool
+    ) throws {
+        try IndexStoreInstrumentation.measure(.symbolRefs, next) { next in
+            typealias Ctx = Context<(next: (IndexStoreSymbolRef) throws -> Bool, scan: RecordScan)>
+            try withRecordReader(for: record) { reader in
+                let scan = RecordScan(lib: lib, reader: reader, record: record)
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, scan), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.record_reader_symbols_apply_f(reader.reader, true, ctx) { ctx, symbol -> Bool in
+                        let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                        let sym = IndexStoreSymbolRef(symbol: symbol, scan: ctx.content.scan)
+                        do { return try ctx.content.next(sym) } catch {
+                            ctx.error = error
+                            return false
+                        }
+                    }
+                    if let error = handler.error {
+                        throw error
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+import Foundation
+
+public enum IndexStoreQuery: Equatable {
+    /// Occurrences referencing the symbol with this USR.
+    case references(usr: String)
+    /// Definitions of the symbols with this name.
+    case definitions(name: String)
+    /// Names of the units built from the source file at this path.
+    case units(path: String)
+    /// Occurrences of the source file at `path` located on `lines`.
+    case occurrences(path: String, lines: ClosedRange<Int64>)
+}
+
+public struct IndexStoreQueryOccurrence: Equatable {
+    public var usr: String
+    public var name: String?
+    public var path: String?
+    public var line: Int64
+    public var column: Int64
+    public var roles: IndexStoreOccurrence.Role
+
+    public init(usr: String, name: String?, path: String?, line: Int64, column: Int64, roles: IndexStoreOccurrence.Role) {
+        self.usr = usr
+        self.name = name
+        self.path = path
+        self.line = line
+        self.column = column
+        self.roles = roles
+    }
+}
+
+public enum IndexStoreQueryResult: Equatable {
+    case occurrences([IndexStoreQueryOccurrence])
+    case units([String])
+    case failure(String)
+}
+
+/// Answers `IndexStoreQuery`s from in-memory indexes of a store.
+///
+/// The indexes are built by a single concurrent pass over the distinct
+/// records on first use, or by `warm()`, and kept until `invalidate()`.
+/// Line range queries go to the store itself and benefit from its reader
+/// caches. Queries can run from several threads at once.
+public final class IndexStoreQueryEngine {
+
+    private struct Posting {
+        var record: Int32
+        var line: UInt32
+        var column: UInt32
+        var roles: IndexStoreOccurrence.Role
+    }
+
+    private struct Index {
+        typealias ID = IndexStoreStringInterner.ID
+
+        let strings: IndexStoreStringInterner
+        /// Paths of the distinct records, indexed by `Posting.record`.
+        let recordPaths: [ID?]
+        /// Postings of each USR, ordered by record, line and column.
+        let postings: [ID: [Posting]]
+        let names: [ID: ID]
+        /// USRs of the symbols defined with each name.
+        let definitions: [ID: [ID]]
+        let units: [String: [String]]
+    }
+
+    public let store: IndexStore
+    public let includeSystem: Bool
+    public let workerCount: Int
+    private let lock = UnfairLock()
+    private var index: Index?
+
+    public init(store: IndexStore, includeSystem: Bool = false, workerCount: Int = IndexStore.defaultWorkerCount) {
+        self.store = store
+        self.includeSystem = includeSystem
+        self.workerCount = workerCount
+    }
+
+    /// Builds the indexes now rather than on the first query.
+    public func warm() throws {
+        _ = try currentIndex()
+    }
+
+    /// Drops the indexes, e.g. after the store changed. The next query
+    /// rebuilds them, reading `units` with fresh readers. When `units` is
+    /// `nil`, every unit is read again.
+    public func invalidate(units: [IndexStoreUnit]? = nil) {
+        lock.perform { index = nil }
+        if let units {
+            store.invalidateUnitReaders(for: units)
+        } else {
+            store.invalidateUnitReaders()
+        }
+        store.invalidateRecordPathMap()
+    }
+
+    public func run(_ queries: [IndexStoreQuery]) -> [IndexStoreQueryResult] {
+        queries.map { run($0) }
+    }
+
+    public func run(_ query: IndexStoreQuery) -> IndexStoreQueryResult {
+        do {
+            switch query {
+            case .references(let usr):
+                return .occurrences(try occurrences(ofUSRs: [usr], roles: .reference))
+            case .definitions(let name):
+                let index = try currentIndex()
+                let usrs = index.strings.id(for: name).flatMap { index.definitions[$0] } ?? []
+                return .occurrences(try occurrences(ofUSRs: usrs.map(index.strings.string(for:)), roles: .definition))
+            case .units(let path):
+                return .units(try currentIndex().units[path] ?? [])
+            case .occurrences(let path, let lines):
+                return .occurrences(try occurrences(atPath: path, lines: lines))
+            }
+        } catch {
+            return .failure(error.localizedDescription)
+        }
+    }
+
+    private func currentIndex() throws -> Index {
+        // Concurrent first queries wait for a single build.
+        try lock.perform {
+            if let index {
+                return index
+            }
+            let built = try buildIndex()
+            index = built
+            return built
+        }
+    }
+
+    private func occurrences(ofUSRs usrs: [String], roles: IndexStoreOccurrence.Role) throws -> [IndexStoreQueryOccurrence] {
+        let index = try currentIndex()
+        var result: [IndexStoreQueryOccurrence] = []
+        for usr in usrs {
+            guard let id = index.strings.id(for: usr), let postings = index.postings[id] else { continue }
+            let name = index.names[id].map(index.strings.string(for:))
+            for posting in postings where !posting.roles.isDisjoint(with: roles) {
+                result.append(IndexStoreQueryOccurrence(
+                    usr: usr,
+                    name: name,
+                    path: index.recordPaths[Int(posting.record)].map(index.strings.string(for:)),
+                    line: Int64(posting.line),
+                    column: Int64(posting.column),
+                    roles: posting.roles
+                ))
+            }
+        }
+        return result
+    }
+
+    /// Occurrences found in more than one record of the file are reported
+    /// once.
+    private func occurrences(atPath path: String, lines: ClosedRange<Int64>) throws -> [IndexStoreQueryOccurrence] {
+        var result: [IndexStoreQueryOccurrence] = []
+        var seen = Set<String>()
+        for record in try store.records(forPath: path) {
+            try store.forEachOccurrences(for: record, lines: lines) { occurrence in
+                let usr = occurrence.symbol.usr ?? ""
+                let location = occurrence.location
+                guard seen.insert("\(usr):\(location.line):\(location.column):\(occurrence.roles.rawValue)").inserted else {
+                    return true
+                }
+                result.append(IndexStoreQueryOccurrence(
+                    usr: usr,
+                    name: occurrence.symbol.name,
+                    path: location.path,
+                    line: location.line,
+                    column: location.column,
+                    roles: occurrence.roles
+                ))
+                return true
+            }
+        }
+        result.sort { ($0.line, $0.column) < ($1.line, $1.column) }
+        return result
+    }
+
+    private func buildIndex() throws -> Index {
+        typealias ID = IndexStoreStringInterner.ID
+        let ownership = try store.recordOwnership(includeSystem: includeSystem, workerCount: workerCount)
+        let strings = IndexStoreStringInterner()
+        let scanned = try store.concurrentMap(ownership.records, workerCount: workerCount) { entry in
+            var occurrences: [(usr: ID, name: ID, line: UInt32, column: UInt32, roles: IndexStoreOccurrence.Role)] = []
+            try store.forEachOccurrenceRefs(for: entry.record) { occurrence in
+                let symbol = occurrence.symbol
+                guard !symbol.usr.isEmpty else { return true }
+                let (line, column) = occurrence.lineAndColumn
+                occurrences.append((
+                    strings.intern(symbol.usr), strings.intern(symbol.name),
+                    UInt32(clamping: line), UInt32(clamping: column), occurrence.roles
+                ))
+                return true
+            }
+            return occurrences
+        }
+
+        var postings: [ID: [Posting]] = [:]
+        var names: [ID: ID] = [:]
+        var definitions: [ID: Set<ID>] = [:]
+        for (record, occurrences) in scanned.enumerated() {
+            for occurrence in occurrences {
+                postings[occurrence.usr, default: []].append(Posting(
+                    record: Int32(record), line: occurrence.line,
+                    column: occurrence.column, roles: occurrence.roles
+                ))
+                names[occurrence.usr] = occurrence.name
+                if occurrence.roles.contains(.definition) {
+                    definitions[occurrence.name, default: []].insert(occurrence.usr)
+                }
+            }
+        }
+
+        var units: [String: [String]] = [:]
+        for entry in ownership.records {
+            guard let path = entry.record.filePath else { continue }
+            units[path, default: []].append(contentsOf: entry.units.compactMap(\.name))
+        }
+        return Index(
+            strings: strings,
+            recordPaths: ownership.records.map { entry in entry.record.filePath.map { strings.intern($0) } },
+            postings: postings,
+            names: names,
+            definitions: definitions.mapValues { $0.sorted() },
+            units: units.mapValues { Array(Set($0)).sorted() }
+        )
+    }
+}
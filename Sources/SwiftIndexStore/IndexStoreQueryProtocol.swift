@@ -0,0 +1,263 @@
+import Foundation
+
+/// Encoding of query batches and their results on the wire.
+///
+/// Each message is a 4-byte little endian payload length followed by the
+/// payload, which starts with the protocol version. Integers are unsigned
+/// LEB128 varints. Strings in results are a varint `n`: 0 is a null string,
+/// 1 introduces a new string as a byte length and UTF-8 bytes, and `n >= 2`
+/// refers to the `n - 2`th string introduced so far in the message. Strings
+/// in requests are a byte length and UTF-8 bytes.
+///
+///     request   version, query count, queries
+///     query     1 references: usr
+///               2 definitions: name
+///               3 units: path
+///               4 occurrences: path, first line, last line
+///     response  version, result count, results in query order
+///     result    1 occurrences: count, then usr, name, path, line, column,
+///                 roles of each
+///               2 units: count, unit names
+///               3 failure: message
+enum IndexStoreQueryProtocol {
+    static let version: UInt64 = 1
+    /// Larger messages are rejected rather than buffered.
+    static let maximumMessageLength = 256 << 20
+
+    private enum QueryTag: UInt8 {
+        case references = 1
+        case definitions
+        case units
+        case occurrences
+    }
+
+    private enum ResultTag: UInt8 {
+        case occurrences = 1
+        case units
+        case failure
+    }
+
+    /// A whole request message, length included.
+    static func encode(_ queries: [IndexStoreQuery]) -> [UInt8] {
+        var writer = MessageWriter()
+        writer.write(varint: version)
+        writer.write(varint: UInt64(queries.count))
+        for query in queries {
+            switch query {
+            case .references(let usr):
+                writer.write(byte: QueryTag.references.rawValue)
+                writer.write(string: usr)
+            case .definitions(let name):
+                writer.write(byte: QueryTag.definitions.rawValue)
+                writer.write(string: name)
+            case .units(let path):
+                writer.write(byte: QueryTag.units.rawValue)
+                writer.write(string: path)
+            case .occurrences(let path, let lines):
+                writer.write(byte: QueryTag.occurrences.rawValue)
+                writer.write(string: path)
+                writer.write(varint: UInt64(clamping: lines.lowerBound))
+                writer.write(varint: UInt64(clamping: lines.upperBound))
+            }
+        }
+        return writer.finish()
+    }
+
+    /// Decodes a request payload, without its length.
+    static func decodeQueries(_ payload: [UInt8]) throws -> [IndexStoreQuery] {
+        var reader = try MessageReader(payload)
+        return try (0..<reader.readCount()).map { _ -> IndexStoreQuery in
+            switch QueryTag(rawValue: try reader.readByte()) {
+            case .references:
+                return .references(usr: try reader.readString())
+            case .definitions:
+                return .definitions(name: try reader.readString())
+            case .units:
+                return .units(path: try reader.readString())
+            case .occurrences:
+                let path = try reader.readString()
+                let first = Int64(clamping: try reader.readVarint())
+                let last = Int64(clamping: try reader.readVarint())
+                guard first <= last else {
+                    throw IndexStoreError.invalidQueryMessage("empty line range \(first)-\(last)")
+                }
+                return .occurrences(path: path, lines: first...last)
+            case nil:
+                throw IndexStoreError.invalidQueryMessage("unknown query")
+            }
+        }
+    }
+
+    /// A whole response message, length included.
+    static func encode(_ results: [IndexStoreQueryResult]) -> [UInt8] {
+        var writer = MessageWriter()
+        writer.write(varint: version)
+        writer.write(varint: UInt64(results.count))
+        for result in results {
+            switch result {
+            case .occurrences(let occurrences):
+                writer.write(byte: ResultTag.occurrences.rawValue)
+                writer.write(varint: UInt64(occurrences.count))
+                for occurrence in occurrences {
+                    writer.write(tableString: occurrence.usr)
+                    writer.write(tableString: occurrence.name)
+                    writer.write(tableString: occurrence.path)
+                    writer.write(varint: UInt64(clamping: occurrence.line))
+                    writer.write(varint: UInt64(clamping: occurrence.column))
+                    writer.write(varint: occurrence.roles.rawValue)
+                }
+            case .units(let units):
+                writer.write(byte: ResultTag.units.rawValue)
+                writer.write(varint: UInt64(units.count))
+                for unit in units {
+                    writer.write(tableString: unit)
+                }
+            case .failure(let message):
+                writer.write(byte: ResultTag.failure.rawValue)
+                writer.write(string: message)
+            }
+        }
+        return writer.finish()
+    }
+
+    /// Decodes a response payload, without its length.
+    static func decodeResults(_ payload: [UInt8]) throws -> [IndexStoreQueryResult] {
+        var reader = try MessageReader(payload)
+        return try (0..<reader.readCount()).map { _ -> IndexStoreQueryResult in
+            switch ResultTag(rawValue: try reader.readByte()) {
+            case .occurrences:
+                return .occurrences(try (0..<reader.readCount()).map { _ in
+                    IndexStoreQueryOccurrence(
+                        usr: try reader.readTableString() ?? "",
+                        name: try reader.readTableString(),
+                        path: try reader.readTableString(),
+                        line: Int64(clamping: try reader.readVarint()),
+                        column: Int64(clamping: try reader.readVarint()),
+                        roles: IndexStoreOccurrence.Role(rawValue: try reader.readVarint())
+                    )
+                })
+            case .units:
+                return .units(try (0..<reader.readCount()).map { _ in try reader.readTableString() ?? "" })
+            case .failure:
+                return .failure(try reader.readString())
+            case nil:
+                throw IndexStoreError.invalidQueryMessage("unknown result")
+            }
+        }
+    }
+
+    private struct MessageWriter {
+        /// Starts with room for the length, filled in by `finish()`.
+        private var bytes: [UInt8] = [0, 0, 0, 0]
+        private var stringIndices: [String: UInt64] = [:]
+
+        mutating func write(byte: UInt8) {
+            bytes.append(byte)
+        }
+
+        mutating func write(varint value: UInt64) {
+            var value = value
+            while value >= 0x80 {
+                bytes.append(UInt8(truncatingIfNeeded: value) | 0x80)
+                value >>= 7
+            }
+            bytes.append(UInt8(value))
+        }
+
+        mutating func write(string: String) {
+            write(varint: UInt64(string.utf8.count))
+            bytes.append(contentsOf: string.utf8)
+        }
+
+        mutating func write(tableString string: String?) {
+            guard let string else {
+                write(varint: 0)
+                return
+            }
+            if let index = stringIndices[string] {
+                write(varint: index + 2)
+                return
+            }
+            stringIndices[string] = UInt64(stringIndices.count)
+            write(varint: 1)
+            write(string: string)
+        }
+
+        func finish() -> [UInt8] {
+            var bytes = self.bytes
+            withUnsafeBytes(of: UInt32(bytes.count - 4).littleEndian) { length in
+                bytes.replaceSubrange(0..<4, with: length)
+            }
+            return bytes
+        }
+    }
+
+    private struct MessageReader {
+        private let bytes: [UInt8]
+        private var offset = 0
+        private var strings: [String] = []
+
+        init(_ bytes: [UInt8]) throws {
+            self.bytes = bytes
+            let version = try readVarint()
+            guard version == IndexStoreQueryProtocol.version else {
+                throw IndexStoreError.invalidQueryMessage("unsupported version \(version)")
+            }
+        }
+
+        mutating func readByte() throws -> UInt8 {
+            guard offset < bytes.count else {
+                throw IndexStoreError.invalidQueryMessage("truncated message")
+            }
+            defer { offset += 1 }
+            return bytes[offset]
+        }
+
+        mutating func readVarint() throws -> UInt64 {
+            var value: UInt64 = 0
+            var shift: UInt64 = 0
+            while true {
+                let byte = try readByte()
+                guard shift < 64 else {
+                    throw IndexStoreError.invalidQueryMessage("varint overflow")
+                }
+                value |= UInt64(byte & 0x7f) << shift
+                if byte & 0x80 == 0 {
+                    return value
+                }
+                shift += 7
+            }
+        }
+
+        /// Reads an element count, which can't exceed the remaining bytes.
+        mutating func readCount() throws -> Int {
+            let count = try readVarint()
+            guard count <= UInt64(bytes.count - offset) else {
+                throw IndexStoreError.invalidQueryMessage("count \(count) exceeds the message")
+            }
+            return Int(count)
+        }
+
+        mutating func readString() throws -> String {
+            let count = try readCount()
+            defer { offset += count }
+            return String(decoding: bytes[offset..<(offset + count)], as: UTF8.self)
+        }
+
+        mutating func readTableString() throws -> String? {
+            switch try readVarint() {
+            case 0:
+                return nil
+            case 1:
+                let string = try readString()
+                strings.append(string)
+                return string
+            case let index:
+                guard index - 2 < UInt64(strings.count) else {
+                    throw IndexStoreError.invalidQueryMessage("unknown string \(index - 2)")
+                }
+                return strings[Int(index - 2)]
+            }
+        }
+    }
+}
@@ -0,0 +1,278 @@
+import Foundation
+#if canImport(Glibc)
+import Glibc
+#elseif canImport(Darwin)
+import Darwin
+#endif
+
+/// Serves an `IndexStoreQueryEngine` on a Unix domain socket.
+///
+/// Each connection is served on its own thread and may send any number of
+/// requests, each answered before the next one is read. Use
+/// `IndexStoreQueryClient` to connect.
+public final class IndexStoreQueryServer {
+    public let engine: IndexStoreQueryEngine
+    public let socketPath: String
+    private let listener: Int32
+    private let lock = UnfairLock()
+    private var isStopped = false
+
+    /// Listens on `socketPath`, replacing a socket file left behind by an
+    /// earlier server.
+    public init(engine: IndexStoreQueryEngine, socketPath: String) throws {
+        self.engine = engine
+        self.socketPath = socketPath
+        unlink(socketPath)
+        self.listener = try UnixSocket.makeListener(path: socketPath)
+    }
+
+    deinit {
+        stop()
+    }
+
+    /// Accepts connections until `stop()` is called, then removes the socket
+    /// file. Throws, after the same cleanup, if accepting fails for a reason
+    /// other than running out of descriptors or memory, which is retried
+    /// after a pause.
+    public func run() throws {
+        defer {
+            close(listener)
+            unlink(socketPath)
+        }
+        while true {
+            let connection = try UnixSocket.acceptConnection(listener)
+            if lock.perform({ isStopped }) {
+                if let connection {
+                    close(connection)
+                }
+                return
+            }
+            guard let connection else {
+                // Accepting again right away would fail the same way until
+                // descriptors are released.
+                usleep(100_000)
+                continue
+            }
+            let engine = self.engine
+            Thread.detachNewThread {
+                Self.serve(connection, engine: engine)
+            }
+        }
+    }
+
+    public func stop() {
+        let wasStopped = lock.perform { () -> Bool in
+            defer { isStopped = true }
+            return isStopped
+        }
+        guard !wasStopped else { return }
+        // Wakes up a blocked accept.
+        if let connection = try? UnixSocket.makeConnection(path: socketPath) {
+            close(connection)
+        }
+    }
+
+    private static func serve(_ connection: Int32, engine: IndexStoreQueryEngine) {
+        defer { close(connection) }
+        while let payload = try? UnixSocket.readMessage(connection) {
+            let results: [IndexStoreQueryResult]
+            do {
+                results = engine.run(try IndexStoreQueryProtocol.decodeQueries(payload))
+            } catch {
+                // The request can't be answered query by query.
+                try? UnixSocket.writeMessage(IndexStoreQueryProtocol.encode([.failure(error.localizedDescription)]), to: connection)
+                return
+            }
+            guard (try? UnixSocket.writeMessage(IndexStoreQueryProtocol.encode(results), to: connection)) != nil else {
+                return
+            }
+        }
+    }
+}
+
+/// A connection to an `IndexStoreQueryServer`. Requests from several threads
+/// are sent one at a time.
+public final class IndexStoreQueryClient {
+    private let connection: Int32
+    private let lock = UnfairLock()
+
+    public init(socketPath: String) throws {
+        self.connection = try UnixSocket.makeConnection(path: socketPath)
+    }
+
+    deinit {
+        close(connection)
+    }
+
+    /// Sends `queries` as one request and returns their results in the same
+    /// order.
+    public func run(_ queries: [IndexStoreQuery]) throws -> [IndexStoreQueryResult] {
+        let results = try lock.perform { () -> [IndexStoreQueryResult] in
+            try UnixSocket.writeMessage(IndexStoreQueryProtocol.encode(queries), to: connection)
+            guard let payload = try UnixSocket.readMessage(connection) else {
+                throw IndexStoreError.socketError("connection closed by the server")
+            }
+            return try IndexStoreQueryProtocol.decodeResults(payload)
+        }
+        if results.count != queries.count, results.count == 1, case .failure(let message) = results[0] {
+            throw IndexStoreError.socketError(message)
+        }
+        guard results.count == queries.count else {
+            throw IndexStoreError.invalidQueryMessage("\(results.count) results for \(queries.count) queries")
+        }
+        return results
+    }
+
+    public func run(_ query: IndexStoreQuery) throws -> IndexStoreQueryResult {
+        try run([query])[0]
+    }
+}
+
+/// Blocking stream sockets in the Unix domain.
+enum UnixSocket {
+    #if canImport(Glibc)
+    private static let streamType = Int32(SOCK_STREAM.rawValue)
+    private static let sendFlags = Int32(MSG_NOSIGNAL)
+    #else
+    private static let streamType = SOCK_STREAM
+    private static let sendFlags: Int32 = 0
+    #endif
+
+    static func makeListener(path: String) throws -> Int32 {
+        let socket = try makeSocket()
+        do {
+            try withAddress(path) { address, length in
+                try check(bind(socket, address, length), "bind \(path)")
+            }
+            try check(listen(socket, SOMAXCONN), "listen on \(path)")
+        } catch {
+            close(socket)
+            throw error
+        }
+        return socket
+    }
+
+    static func makeConnection(path: String) throws -> Int32 {
+        let socket = try makeSocket()
+        do {
+            try withAddress(path) { address, length in
+                try check(connect(socket, address, length), "connect to \(path)")
+            }
+        } catch {
+            close(socket)
+            throw error
+        }
+        return socket
+    }
+
+    /// The accepted connection, or `nil` if the process or system is out of
+    /// descriptors or buffers for now.
+    static func acceptConnection(_ listener: Int32) throws -> Int32? {
+        while true {
+            let connection = accept(listener, nil, nil)
+            if connection >= 0 {
+                try? disableSigpipe(connection)
+                return connection
+            }
+            switch errno {
+            case EINTR, ECONNABORTED:
+                continue
+            case EMFILE, ENFILE, ENOBUFS, ENOMEM:
+                return nil
+            default:
+                try check(-1, "accept")
+            }
+        }
+    }
+
+    /// Writes a message encoded with its length.
+    static func writeMessage(_ bytes: [UInt8], to socket: Int32) throws {
+        try bytes.withUnsafeBytes { buffer in
+            var offset = 0
+            while offset < buffer.count {
+                let written = send(socket, buffer.baseAddress! + offset, buffer.count - offset, sendFlags)
+                if written < 0 {
+                    if errno == EINTR { continue }
+                    try check(-1, "send")
+                }
+                offset += written
+            }
+        }
+    }
+
+    /// Reads the payload of one length prefixed message, or returns `nil` if
+    /// the peer closed the connection between messages.
+    static func readMessage(_ socket: Int32) throws -> [UInt8]? {
+        guard let header = try readBytes(count: 4, from: socket, allowsEOF: true) else {
+            return nil
+        }
+        let length = Int(UInt32(header[0]) | UInt32(header[1]) << 8 | UInt32(header[2]) << 16 | UInt32(header[3]) << 24)
+        guard length <= IndexStoreQueryProtocol.maximumMessageLength else {
+            throw IndexStoreError.invalidQueryMessage("message of \(length) bytes is too large")
+        }
+        return try readBytes(count: length, from: socket, allowsEOF: false)
+    }
+
+    private static func readBytes(count: Int, from socket: Int32, allowsEOF: Bool) throws -> [UInt8]? {
+        var bytes = [UInt8](repeating: 0, count: count)
+        var offset = 0
+        while offset < count {
+            let received = bytes.withUnsafeMutableBytes { buffer in
+                recv(socket, buffer.baseAddress! + offset, count - offset, 0)
+            }
+            if received < 0 {
+                if errno == EINTR { continue }
+                try check(-1, "recv")
+            }
+            if received == 0 {
+                if allowsEOF, offset == 0 {
+                    return nil
+                }
+                throw IndexStoreError.socketError("connection closed in the middle of a message")
+            }
+            offset += received
+        }
+        return bytes
+    }
+
+    private static func makeSocket() throws -> Int32 {
+        let descriptor = socket(AF_UNIX, streamType, 0)
+        try check(descriptor, "socket")
+        try disableSigpipe(descriptor)
+        return descriptor
+    }
+
+    /// Writing to a closed connection fails instead of killing the process.
+    private static func disableSigpipe(_ socket: Int32) throws {
+        #if canImport(Darwin)
+        var on: Int32 = 1
+        try check(setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, socklen_t(MemoryLayout<Int32>.size)), "setsockopt")
+        #endif
+    }
+
+    private static func withAddress<T>(_ path: String, _ body: (UnsafePointer<sockaddr>, socklen_t) throws -> T) throws -> T {
+        var address = sockaddr_un()
+        address.sun_family = sa_family_t(AF_UNIX)
+        let bytes = Array(path.utf8)
+        guard bytes.count < MemoryLayout.size(ofValue: address.sun_path) else {
+            throw IndexStoreError.socketError("socket path is too long: \(path)")
+        }
+        withUnsafeMutableBytes(of: &address.sun_path) { buffer in
+            buffer.copyBytes(from: bytes)
+        }
+        #if canImport(Darwin)
+        address.sun_len = UInt8(MemoryLayout<sockaddr_un>.size)
+        #endif
+        return try withUnsafePointer(to: &address) { pointer in
+            try pointer.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+                try body($0, socklen_t(MemoryLayout<sockaddr_un>.size))
+            }
+        }
+    }
+
+    private static func check<T: BinaryInteger>(_ result: T, _ operation: String) throws {
+        guard result >= 0 else {
+            throw IndexStoreError.socketError("\(operation): \(String(cString: strerror(errno)))")
+        }
+    }
+}
@@ -0,0 +1,76 @@
+import Foundation
+
+/// Every distinct record in a store together with the units that depend on it.
+public struct IndexStoreRecordOwnership {
+    public struct Entry {
+        public var record: IndexStoreUnit.Dependency.Record
+        public var units: [IndexStoreUnit]
+    }
+
+    /// Distinct records, in the order they are first seen by a serial unit walk.
+    public var records: [Entry]
+
+    /// Number of `.record` dependencies over all visited units, duplicates included.
+    public var dependencyCount: Int
+
+    public var distinctRecordCount: Int {
+        records.count
+    }
+
+    /// How many record dependencies share each distinct record on average.
+    public var dedupRatio: Double {
+        guard !records.isEmpty else { return 1 }
+        return Double(dependencyCount) / Double(records.count)
+    }
+}
+
+extension IndexStore {
+
+    public func recordOwnership(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> IndexStoreRecordOwnership {
+        let unitRecords = try concurrentMapUnits(includeSystem: includeSystem, workerCount: workerCount) { unit in
+            try (unit, recordDependencies(for: unit).compactMap(\.record))
+        }
+
+        var entries: [IndexStoreRecordOwnership.Entry] = []
+        var entryIndices: [String: Int] = [:]
+        var dependencyCount = 0
+        for (unit, records) in unitRecords {
+            for record in records {
+                guard let name = record.name else { continue }
+                dependencyCount += 1
+                if let index = entryIndices[name] {
+                    entries[index].units.append(unit)
+                } else {
+                    entryIndices[name] = entries.count
+                    entries.append(.init(record: record, units: [unit]))
+                }
+            }
+        }
+        return IndexStoreRecordOwnership(records: entries, dependencyCount: dependencyCount)
+    }
+
+    /// Visits each distinct record of the store exactly once, no matter how many
+    /// units depend on it.
+    public func forEachDistinctRecords(
+        includeSystem: Bool = true,
+        _ next: (IndexStoreRecordOwnership.Entry) throws -> Bool
+    ) throws {
+        for entry in try recordOwnership(includeSystem: includeSystem).records {
+            guard try next(entry) else { break }
+        }
+    }
+
+    /// Applies `transform` to each distinct record on a pool of `workerCount`
+    /// workers. Results are returned in `recordOwnership().records` order.
+    public func concurrentMapDistinctRecords<T>(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        _ transform: (IndexStoreRecordOwnership.Entry) throws -> T
+    ) throws -> [T] {
+        let ownership = try recordOwnership(includeSystem: includeSystem, workerCount: workerCount)
+        return try concurrentMap(ownership.records, workerCount: workerCount, transform)
+    }
+}
@@ -0,0 +1,175 @@
+import Foundation
+
+/// Call, inheritance, override and extension relations of every symbol of a
+/// store, keyed by interned USR.
+///
+/// Each relation kind is kept in compressed sparse row form in both
+/// directions, so callers and callees are looked up with the same cost.
+/// Repeated edges, such as several calls from one function to another, are
+/// stored once. The graph is immutable and can be queried from any thread.
+public final class IndexStoreRelationGraph {
+
+    public enum Kind: Int, CaseIterable {
+        /// Caller to callee.
+        case call
+        /// Subtype to supertype, including protocol conformances.
+        case inheritance
+        /// Overriding member to overridden member.
+        case override
+        /// Extended type to extension.
+        case `extension`
+    }
+
+    public struct Edge: Hashable {
+        public var kind: Kind
+        public var source: IndexStoreStringInterner.ID
+        public var target: IndexStoreStringInterner.ID
+
+        public init(kind: Kind, source: IndexStoreStringInterner.ID, target: IndexStoreStringInterner.ID) {
+            self.kind = kind
+            self.source = source
+            self.target = target
+        }
+    }
+
+    /// The interner the USRs of the graph are interned in.
+    public let strings: IndexStoreStringInterner
+    /// USRs of every symbol having at least one relation.
+    public let nodes: [IndexStoreStringInterner.ID]
+    private let nodeIndices: [IndexStoreStringInterner.ID: Int32]
+    /// Indexed by `Kind.rawValue`.
+    private let outgoing: [CompressedAdjacency]
+    private let incoming: [CompressedAdjacency]
+
+    public init(edges: [Edge], strings: IndexStoreStringInterner) {
+        var nodes: [IndexStoreStringInterner.ID] = []
+        var nodeIndices: [IndexStoreStringInterner.ID: Int32] = [:]
+        func node(_ usr: IndexStoreStringInterner.ID) -> Int32 {
+            if let index = nodeIndices[usr] { return index }
+            let index = Int32(nodes.count)
+            nodes.append(usr)
+            nodeIndices[usr] = index
+            return index
+        }
+        var edgesByKind = [[(Int32, Int32)]](repeating: [], count: Kind.allCases.count)
+        for edge in edges {
+            edgesByKind[edge.kind.rawValue].append((node(edge.source), node(edge.target)))
+        }
+
+        self.strings = strings
+        self.nodes = nodes
+        self.nodeIndices = nodeIndices
+        self.outgoing = edgesByKind.map {
+            CompressedAdjacency(nodeCount: nodes.count, edges: $0, deduplicated: true)
+        }
+        self.incoming = edgesByKind.map {
+            CompressedAdjacency(nodeCount: nodes.count, edges: $0.map { ($1, $0) }, deduplicated: true)
+        }
+    }
+
+    /// Number of distinct edges of all kinds.
+    public var edgeCount: Int {
+        outgoing.reduce(0) { $0 + $1.edgeCount }
+    }
+
+    /// Symbols related to `usr` by `kind`, following edges forward, or
+    /// backward when `inverse` is set.
+    public func related(
+        to usr: IndexStoreStringInterner.ID,
+        by kind: Kind,
+        inverse: Bool = false,
+        transitive: Bool = false
+    ) -> [IndexStoreStringInterner.ID] {
+        guard let index = nodeIndices[usr] else { return [] }
+        let adjacency = inverse ? incoming[kind.rawValue] : outgoing[kind.rawValue]
+        let targets = transitive ? adjacency.reachable(from: index).dropFirst() : adjacency[Int(index)]
+        return targets.map { nodes[Int($0)] }
+    }
+
+    /// Functions calling `usr`.
+    public func callers(of usr: String) -> [String] {
+        relatedUSRs(of: usr, by: .call, inverse: true, transitive: false)
+    }
+
+    /// Functions called by `usr`.
+    public func callees(of usr: String) -> [String] {
+        relatedUSRs(of: usr, by: .call, inverse: false, transitive: false)
+    }
+
+    /// Classes and protocols `usr` inherits from or conforms to.
+    public func superclasses(of usr: String, transitive: Bool = false) -> [String] {
+        relatedUSRs(of: usr, by: .inheritance, inverse: false, transitive: transitive)
+    }
+
+    /// Types inheriting from or conforming to `usr`.
+    public func subclasses(of usr: String, transitive: Bool = false) -> [String] {
+        relatedUSRs(of: usr, by: .inheritance, inverse: true, transitive: transitive)
+    }
+
+    /// Members overriding `usr`, or implementing it for protocol requirements.
+    public func overrides(of usr: String, transitive: Bool = false) -> [String] {
+        relatedUSRs(of: usr, by: .override, inverse: true, transitive: transitive)
+    }
+
+    /// Members `usr` overrides.
+    public func overridden(by usr: String, transitive: Bool = false) -> [String] {
+        relatedUSRs(of: usr, by: .override, inverse: false, transitive: transitive)
+    }
+
+    /// Extensions of the type `usr`.
+    public func extensions(of usr: String) -> [String] {
+        relatedUSRs(of: usr, by: .extension, inverse: false, transitive: false)
+    }
+
+    private func relatedUSRs(of usr: String, by kind: Kind, inverse: Bool, transitive: Bool) -> [String] {
+        guard let id = strings.id(for: usr) else { return [] }
+        return related(to: id, by: kind, inverse: inverse, transitive: transitive).map(strings.string(for:))
+    }
+}
+
+extension IndexStore {
+
+    /// Reads the relations of every distinct record on a pool of
+    /// `workerCount` workers and builds their graph.
+    ///
+    /// Only occurrences carrying one of the collected relations are visited,
+    /// and USRs are interned straight from libIndexStore buffers.
+    public func relationGraph(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount,
+        strings: IndexStoreStringInterner = .init()
+    ) throws -> IndexStoreRelationGraph {
+        let relationRoles: IndexStoreOccurrence.Role = [.calledBy, .baseOf, .overrideOf, .extendedBy]
+        let filter = IndexStoreOccurrenceFilter(roles: relationRoles, includeSystem: includeSystem)
+        let perRecord = try concurrentMapDistinctRecords(includeSystem: includeSystem, workerCount: workerCount) { entry in
+            var edges: [IndexStoreRelationGraph.Edge] = []
+            try forEachOccurrenceRefs(for: entry.record, matching: filter) { occurrence in
+                let usr = occurrence.symbol.usr
+                guard !usr.isEmpty else { return true }
+                let symbol = strings.intern(usr)
+                occurrence.forEachRelation { roles, related in
+                    guard !roles.isDisjoint(with: relationRoles), !related.usr.isEmpty else { return true }
+                    let other = strings.intern(related.usr)
+                    // The occurrence symbol is the callee, base, overriding
+                    // member or extended type of the related symbol.
+                    if roles.contains(.calledBy) {
+                        edges.append(.init(kind: .call, source: other, target: symbol))
+                    }
+                    if roles.contains(.baseOf) {
+                        edges.append(.init(kind: .inheritance, source: other, target: symbol))
+                    }
+                    if roles.contains(.overrideOf) {
+                        edges.append(.init(kind: .override, source: symbol, target: other))
+                    }
+                    if roles.contains(.extendedBy) {
+                        edges.append(.init(kind: .extension, source: symbol, target: other))
+                    }
+                    return true
+                }
+                return true
+            }
+            return edges
+        }
+        return IndexStoreRelationGraph(edges: perRecord.flatMap { $0 }, strings: strings)
+    }
+}
@@ -0,0 +1,195 @@
+import Foundation
+
+/// Maps strings to compact integer IDs and back.
+///
+/// Lookups hash and compare raw UTF-8 bytes, so interning a borrowed
+/// `IndexStoreStringRef` that was seen before doesn't allocate. The table is
+/// split into independently locked shards and can be used from multiple
+/// threads. IDs are only meaningful for the interner that issued them.
+public final class IndexStoreStringInterner {
+
+    public struct ID: Hashable, Comparable {
+        public let rawValue: UInt32
+
+        public init(rawValue: UInt32) {
+            self.rawValue = rawValue
+        }
+
+        public static func < (lhs: ID, rhs: ID) -> Bool {
+            lhs.rawValue < rhs.rawValue
+        }
+    }
+
+    private final class Shard {
+        let lock = UnfairLock()
+        /// UTF-8 bytes of every string of the shard, back to back.
+        var bytes: [UInt8] = []
+        var spans: [(offset: Int, count: Int)] = []
+        /// Hash to the most recently interned local index with that hash.
+        var buckets: [Int: UInt32] = [:]
+        /// Local index to the previous local index in the same bucket.
+        var chain: [UInt32] = []
+
+        func find(_ key: UnsafeRawBufferPointer, hash: Int) -> UInt32? {
+            var candidate = buckets[hash]
+            while let index = candidate {
+                let span = spans[Int(index)]
+                if span.count == key.count {
+                    let isEqual = bytes.withUnsafeBytes { bytes in
+                        memcmpEqual(bytes.baseAddress.map { $0 + span.offset }, key.baseAddress, key.count)
+                    }
+                    if isEqual {
+                        return index
+                    }
+                }
+                let previous = chain[Int(index)]
+                candidate = previous == IndexStoreStringInterner.noIndex ? nil : previous
+            }
+            return nil
+        }
+
+        func insert(_ key: UnsafeRawBufferPointer, hash: Int) -> UInt32 {
+            let index = UInt32(spans.count)
+            spans.append((bytes.count, key.count))
+            bytes.append(contentsOf: key)
+            chain.append(buckets[hash] ?? IndexStoreStringInterner.noIndex)
+            buckets[hash] = index
+            return index
+        }
+    }
+
+    private static let noIndex = UInt32.max
+    private let shards: [Shard]
+    private let shardBits: UInt32
+
+    /// `shardCount` is rounded up to a power of two.
+    public init(shardCount: Int = 16) {
+        var shardBits: UInt32 = 0
+        while (1 << shardBits) < min(max(1, shardCount), 256) {
+            shardBits += 1
+        }
+        self.shardBits = shardBits
+        self.shards = (0..<(1 << shardBits)).map { _ in Shard() }
+    }
+
+    /// Number of distinct strings interned so far.
+    public var count: Int {
+        shards.reduce(0) { count, shard in
+            count + shard.lock.perform { shard.spans.count }
+        }
+    }
+
+    public func intern(_ ref: IndexStoreStringRef) -> ID {
+        ref.withUnsafeBytes(intern(bytes:))
+    }
+
+    public func intern(_ string: String) -> ID {
+        string.withUTF8Bytes(intern(bytes:))
+    }
+
+    /// Returns the ID of `string` if it was interned, without inserting it.
+    public func id(for string: String) -> ID? {
+        string.withUTF8Bytes { key in
+            let hash = Self.hash(key)
+            let shardIndex = self.shardIndex(for: hash)
+            let shard = shards[shardIndex]
+            return shard.lock.perform { shard.find(key, hash: hash) }.map { makeID(local: $0, shard: shardIndex) }
+        }
+    }
+
+    public func string(for id: ID) -> String {
+        withUnsafeBytes(for: id) { String(decoding: $0, as: UTF8.self) }
+    }
+
+    /// Calls `body` with the UTF-8 bytes of the string identified by `id`.
+    /// The bytes are only valid during `body`, which must not intern strings.
+    public func withUnsafeBytes<T>(for id: ID, _ body: (UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+        let shard = shards[Int(id.rawValue & ((1 << shardBits) - 1))]
+        let local = Int(id.rawValue >> shardBits)
+        return try shard.lock.perform {
+            let span = shard.spans[local]
+            return try shard.bytes.withUnsafeBytes {
+                try body(UnsafeRawBufferPointer(rebasing: $0[span.offset..<(span.offset + span.count)]))
+            }
+        }
+    }
+
+    func intern(bytes key: UnsafeRawBufferPointer) -> ID {
+        let hash = Self.hash(key)
+        let shardIndex = self.shardIndex(for: hash)
+        let shard = shards[shardIndex]
+        let local = shard.lock.perform {
+            shard.find(key, hash: hash) ?? shard.insert(key, hash: hash)
+        }
+        return makeID(local: local, shard: shardIndex)
+    }
+
+    private func makeID(local: UInt32, shard: Int) -> ID {
+        precondition(UInt64(local) < UInt64(1) << (32 - shardBits), "Too many strings interned")
+        return ID(rawValue: local << shardBits | UInt32(shard))
+    }
+
+    private func shardIndex(for hash: Int) -> Int {
+        Int(UInt(bitPattern: hash) % UInt(shards.count))
+    }
+
+    private static func hash(_ bytes: UnsafeRawBufferPointer) -> Int {
+        var hasher = Hasher()
+        hasher.combine(bytes: bytes)
+        return hasher.finalize()
+    }
+}
+
+/// A symbol whose strings are interned.
+public struct IndexStoreInternedSymbol: Hashable {
+    public let usr: IndexStoreStringInterner.ID
+    public let name: IndexStoreStringInterner.ID
+    public let kind: IndexStoreSymbol.Kind
+    public let subKind: IndexStoreSymbol.SubKind
+    public let language: IndexStoreSymbol.Language
+}
+
+/// An occurrence whose strings are interned.
+public struct IndexStoreInternedOccurrence: Hashable {
+    public let symbol: IndexStoreInternedSymbol
+    public let roles: IndexStoreOccurrence.Role
+    public let path: IndexStoreStringInterner.ID
+    public let line: UInt32
+    public let column: UInt32
+}
+
+extension IndexStoreSymbolRef {
+    public func interned(in interner: IndexStoreStringInterner) -> IndexStoreInternedSymbol {
+        IndexStoreInternedSymbol(
+            usr: interner.intern(usr),
+            name: interner.intern(name),
+            kind: kind,
+            subKind: subKind,
+            language: language
+        )
+    }
+}
+
+extension IndexStore {
+
+    /// Visits the matching occurrences of `record` with their USRs, names and
+    /// path interned in `interner`.
+    public func forEachInternedOccurrences(
+        for record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter = .init(),
+        interner: IndexStoreStringInterner,
+        _ next: (IndexStoreInternedOccurrence) throws -> Bool
+    ) throws {
+        let path = interner.intern(record.filePath ?? "")
+        try forEachOccurrenceRefs(for: record, matching: filter) { occurrence in
+            let location = occurrence.lineAndColumn
+            return try next(IndexStoreInternedOccurrence(
+                symbol: occurrence.symbol.interned(in: interner),
+                roles: occurrence.roles,
+                path: path,
+                line: UInt32(truncatingIfNeeded: location.line),
+                column: UInt32(truncatingIfNeeded: location.column)
+            ))
+        }
+    }
+}
@@ -0,0 +1,151 @@
+import Foundation
+import _CIndexStore
+
+/// A borrowed UTF-8 string owned by libIndexStore.
+///
+/// Comparing, hashing and prefix checks work on the raw bytes and never
+/// allocate. Refs obtained from an `IndexStoreSymbol` keep the underlying
+/// reader alive and outlive the scan callback, unlike the symbol itself;
+/// refs handed to borrowed callbacks are only valid for the duration of the
+/// callback.
+public struct IndexStoreStringRef {
+    let ref: indexstore_string_ref_t
+    let owner: AnyObject?
+
+    init(_ ref: indexstore_string_ref_t, owner: AnyObject? = nil) {
+        self.ref = ref
+        self.owner = owner
+    }
+
+    public var isNull: Bool {
+        ref.data == nil
+    }
+
+    /// The length in bytes.
+    public var count: Int {
+        ref.length
+    }
+
+    public var isEmpty: Bool {
+        ref.length == 0
+    }
+
+    /// Materializes a `String`, or returns `nil` for a null ref.
+    public var string: String? {
+        ref.toSwiftString()
+    }
+
+    public func withUnsafeBytes<T>(_ body: (UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+        try withExtendedLifetime(owner) {
+            try body(ref.bytes)
+        }
+    }
+
+    public func hasPrefix(_ prefix: String) -> Bool {
+        withUnsafeBytes { bytes in
+            prefix.withUTF8Bytes { prefix in
+                prefix.count <= bytes.count && memcmpEqual(bytes.baseAddress, prefix.baseAddress, prefix.count)
+            }
+        }
+    }
+
+    public func hasPrefix(_ prefix: IndexStoreStringRef) -> Bool {
+        withUnsafeBytes { bytes in
+            prefix.withUnsafeBytes { prefix in
+                prefix.count <= bytes.count && memcmpEqual(bytes.baseAddress, prefix.baseAddress, prefix.count)
+            }
+        }
+    }
+
+    public static func == (lhs: IndexStoreStringRef, rhs: String) -> Bool {
+        lhs.withUnsafeBytes { bytes in
+            rhs.withUTF8Bytes { other in
+                bytes.count == other.count && memcmpEqual(bytes.baseAddress, other.baseAddress, other.count)
+            }
+        }
+    }
+
+    public static func == (lhs: String, rhs: IndexStoreStringRef) -> Bool {
+        rhs == lhs
+    }
+}
+
+extension IndexStoreStringRef: Hashable {
+    public static func == (lhs: IndexStoreStringRef, rhs: IndexStoreStringRef) -> Bool {
+        lhs.withUnsafeBytes { lhs in
+            rhs.withUnsafeBytes { rhs in
+                lhs.count == rhs.count && memcmpEqual(lhs.baseAddress, rhs.baseAddress, lhs.count)
+            }
+        }
+    }
+
+    public func hash(into hasher: inout Hasher) {
+        withUnsafeBytes { hasher.combine(bytes: $0) }
+    }
+}
+
+extension IndexStoreStringRef: CustomStringConvertible {
+    public var description: String {
+        string ?? "nil"
+    }
+}
+
+/// Either a materialized string or a borrowed ref that is decoded on access.
+enum LazyString {
+    case materialized(String?)
+    case borrowed(indexstore_string_ref_t)
+
+    var value: String? {
+        switch self {
+        case .materialized(let string): return string
+        case .borrowed(let ref): return ref.toSwiftString()
+        }
+    }
+}
+
+extension indexstore_string_ref_t {
+    var bytes: UnsafeRawBufferPointer {
+        UnsafeRawBufferPointer(start: data, count: length)
+    }
+
+    func toSwiftString() -> String? {
+        guard data != nil else { return nil }
+        IndexStoreInstrumentation.active?.recordString(bytes: length)
+        return decodeUTF8(bytes)
+    }
+}
+
+/// Decodes `bytes`, or returns `nil` if they aren't valid UTF-8 rather than
+/// substituting replacement characters.
+func decodeUTF8(_ bytes: UnsafeRawBufferPointer) -> String? {
+    // USRs and names are almost always ASCII, which is valid as is.
+    if !bytes.allSatisfy({ $0 < 0x80 }) {
+        var iterator = bytes.makeIterator()
+        var parser = Unicode.UTF8.ForwardParser()
+        parsing: while true {
+            switch parser.parseScalar(from: &iterator) {
+            case .valid: continue
+            case .emptyInput: break parsing
+            case .error: return nil
+            }
+        }
+    }
+    return String(decoding: bytes, as: UTF8.self)
+}
+
+extension String {
+    /// Calls `body` with the UTF-8 bytes of the string, copying only if the
+    /// string is not stored contiguously.
+    func withUTF8Bytes<T>(_ body: (UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+        if let result = try utf8.withContiguousStorageIfAvailable({ try body(UnsafeRawBufferPointer($0)) }) {
+            return result
+        }
+        return try Array(utf8).withUnsafeBytes(body)
+    }
+}
+
+func memcmpEqual(_ lhs: UnsafeRawPointer?, _ rhs: UnsafeRawPointer?, _ count: Int) -> Bool {
+    guard count > 0 else { return true }
+    guard let lhs, let rhs else { return false }
+    return memcmp(lhs, rhs, count) == 0
+}
@@ -109,11 +109,59 @@ public struct IndexStoreSymbol {
         case swift = 100
     }
 
-    public var usr: String?
-    public var name: String?
+    /// Decoded on each access; use `usrRef` to inspect it without allocating.
+    public var usr: String? {
+        get { _usr.value }
+        set { _usr = .materialized(newValue) }
+    }
+
+    /// Decoded on each access; use `nameRef` to inspect it without allocating.
+    public var name: String? {
+        get { _name.value }
+        set { _name = .materialized(newValue) }
+    }
+
     public var kind: Kind
     public var subKind: SubKind
     public var language: Language
 
+    /// The raw USR bytes, or `nil` if `usr` has been reassigned. Unlike the
+    /// symbol's other libIndexStore state, they stay valid after the scan
+    /// callback returns.
+    public var usrRef: IndexStoreStringRef? {
+        guard case let .borrowed(ref) = _usr else { return nil }
+        return IndexStoreStringRef(ref, owner: owner)
+    }
+
+    /// The raw name bytes, or `nil` if `name` has been reassigned. They stay
+    /// valid after the scan callback returns.
+    public var nameRef: IndexStoreStringRef? {
+        guard case let .borrowed(ref) = _name else { return nil }
+        return IndexStoreStringRef(ref, owner: owner)
+    }
+
+    private var _usr: LazyString
+    private var _name: LazyString
+
+    /// Only valid during the scan callback that produced the symbol: without
+    /// a record reader cache, libIndexStore decodes symbols into storage of
+    /// that callback.
     let anchor: indexstore_symbol_t?
+    /// Keeps the reader that the borrowed strings point into alive. It does
+    /// not keep `anchor` valid.
+    let owner: AnyObject?
+
+    init(
+        usr: indexstore_string_ref_t, name: indexstore_string_ref_t,
+        kind: Kind, subKind: SubKind, language: Language,
+        anchor: indexstore_symbol_t?, owner: AnyObject?
+    ) {
+        self._usr = .borrowed(usr)
+        self._name = .borrowed(name)
+        self.kind = kind
+        self.subKind = subKind
+        self.language = language
+        self.anchor = anchor
+        self.owner = owner
+    }
 }
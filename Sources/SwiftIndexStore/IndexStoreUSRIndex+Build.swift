@@ -0,0 +1,288 @@
+import Foundation
+
+extension IndexStoreUSRIndex {
+
+    /// Indexes every distinct record of `store` into a new index file at `url`
+    /// and opens it.
+    ///
+    /// Records already present in `previous` are copied from it instead of
+    /// being read again from libIndexStore. Since record names change whenever
+    /// their content does, passing the last built index makes a rebuild cost
+    /// proportional to the records that changed. The file is replaced
+    /// atomically, so `previous` may live at `url`.
+    @discardableResult
+    public static func build(
+        from store: IndexStore,
+        at url: URL,
+        previous: IndexStoreUSRIndex? = nil,
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> IndexStoreUSRIndex {
+        let formatVersion = Int(store.lib.format_version())
+        var reusable: [String: RecordContent] = [:]
+        if let previous, previous.formatVersion == formatVersion {
+            reusable = previous.recordContents()
+        }
+
+        let ownership = try store.recordOwnership(includeSystem: includeSystem, workerCount: workerCount)
+        let entries = ownership.records.filter { $0.record.name != nil }
+        let contents = try store.concurrentMap(entries, workerCount: workerCount) { entry -> RecordContent in
+            if let content = reusable[entry.record.name!] {
+                return content
+            }
+            return try scan(entry.record, in: store)
+        }
+
+        var writer = USRIndexWriter(formatVersion: formatVersion, includesSystem: includeSystem)
+        for (entry, content) in zip(entries, contents) {
+            writer.add(entry.record, content)
+        }
+        try writer.data().write(to: url, options: .atomic)
+        return try open(at: url)
+    }
+
+    /// The symbols and postings of one record.
+    struct RecordContent {
+        struct Posting {
+            /// Index into `symbols`.
+            var symbol: UInt32
+            var line: UInt32
+            var column: UInt32
+            var roles: UInt64
+        }
+
+        var symbols: [Symbol] = []
+        var postings: [Posting] = []
+    }
+
+    private static func scan(_ record: IndexStoreUnit.Dependency.Record, in store: IndexStore) throws -> RecordContent {
+        var content = RecordContent()
+        // Keys borrow the record reader and are only looked up during the scan.
+        var symbolIndices: [IndexStoreStringRef: UInt32] = [:]
+        try store.forEachOccurrenceRefs(for: record) { occurrence in
+            let symbol = occurrence.symbol
+            let usr = symbol.usr
+            guard !usr.isEmpty else { return true }
+            let index: UInt32
+            if let existing = symbolIndices[usr] {
+                index = existing
+            } else {
+                index = UInt32(content.symbols.count)
+                symbolIndices[usr] = index
+                content.symbols.append(Symbol(
+                    usr: usr.string ?? "",
+                    name: symbol.name.string,
+                    kind: symbol.kind,
+                    subKind: symbol.subKind,
+                    language: symbol.language
+                ))
+            }
+            let location = occurrence.lineAndColumn
+            content.postings.append(.init(
+                symbol: index,
+                line: UInt32(truncatingIfNeeded: location.line),
+                column: UInt32(truncatingIfNeeded: location.column),
+                roles: occurrence.roles.rawValue
+            ))
+            return true
+        }
+        return content
+    }
+
+    /// Splits the postings of the index back into per-record contents, keyed
+    /// by record name.
+    func recordContents() -> [String: RecordContent] {
+        var contents = [RecordContent](repeating: RecordContent(), count: recordCount)
+        // The postings of a symbol are contiguous, so a record only needs to
+        // remember the last symbol it has seen.
+        var lastSymbol = [Int](repeating: -1, count: recordCount)
+        // Records with a symbol that can't be decoded are scanned again.
+        var unreadable = Set<Int>()
+        for index in 0..<symbolCount {
+            guard let symbol = self.symbol(at: index) else {
+                forEachPosting(ofSymbolAt: index) { record, _, _, _ in
+                    unreadable.insert(record)
+                    return true
+                }
+                continue
+            }
+            forEachPosting(ofSymbolAt: index) { record, line, column, roles in
+                if lastSymbol[record] != index {
+                    lastSymbol[record] = index
+                    contents[record].symbols.append(symbol)
+                }
+                contents[record].postings.append(.init(
+                    symbol: UInt32(contents[record].symbols.count - 1),
+                    line: line,
+                    column: column,
+                    roles: roles
+                ))
+                return true
+            }
+        }
+        var result: [String: RecordContent] = [:]
+        for (index, content) in contents.enumerated() where !unreadable.contains(index) {
+            result[recordName(at: index)] = content
+        }
+        return result
+    }
+}
+
+/// Merges per-record contents and serializes them in `USRIndexLayout`.
+struct USRIndexWriter {
+    private struct Posting {
+        var record: UInt32
+        var line: UInt32
+        var column: UInt32
+        var roles: UInt64
+    }
+
+    private let formatVersion: Int
+    private let includesSystem: Bool
+    private var records: [(record: IndexStoreUnit.Dependency.Record, name: String)] = []
+    private var symbols: [IndexStoreUSRIndex.Symbol] = []
+    private var symbolIndices: [String: Int] = [:]
+    private var postings: [[Posting]] = []
+
+    init(formatVersion: Int, includesSystem: Bool) {
+        self.formatVersion = formatVersion
+        self.includesSystem = includesSystem
+    }
+
+    mutating func add(_ record: IndexStoreUnit.Dependency.Record, _ content: IndexStoreUSRIndex.RecordContent) {
+        let recordIndex = UInt32(records.count)
+        records.append((record, record.name ?? ""))
+        let globalIndices = content.symbols.map { symbol -> Int in
+            if let index = symbolIndices[symbol.usr] {
+                return index
+            }
+            symbolIndices[symbol.usr] = symbols.count
+            symbols.append(symbol)
+            postings.append([])
+            return symbols.count - 1
+        }
+        for posting in content.postings {
+            postings[globalIndices[Int(posting.symbol)]].append(
+                Posting(record: recordIndex, line: posting.line, column: posting.column, roles: posting.roles)
+            )
+        }
+    }
+
+    func data() throws -> Data {
+        let usrBytes = symbols.map { Array($0.usr.utf8) }
+        let order = symbols.indices.sorted { lhs, rhs in
+            usrBytes[lhs].lexicographicallyPrecedes(usrBytes[rhs])
+        }
+        let postingCount = postings.reduce(0) { $0 + $1.count }
+
+        var strings = StringTable()
+        let recordTableOffset = USRIndexLayout.headerSize
+        let symbolTableOffset = recordTableOffset + records.count * USRIndexLayout.recordEntrySize
+        let postingsOffset = symbolTableOffset + symbols.count * USRIndexLayout.symbolEntrySize
+        let stringsOffset = postingsOffset + postingCount * USRIndexLayout.postingSize
+
+        var buffer = BinaryBuffer()
+        buffer.reserveCapacity(stringsOffset)
+
+        buffer.append(USRIndexLayout.magic)
+        buffer.append(USRIndexLayout.version)
+        buffer.append(UInt32(formatVersion))
+        buffer.append(includesSystem ? USRIndexLayout.includesSystemFlag : 0)
+        buffer.append(UInt32(records.count))
+        buffer.append(UInt32(symbols.count))
+        buffer.append(UInt32(0))
+        buffer.append(UInt64(postingCount))
+        buffer.append(UInt64(recordTableOffset))
+        buffer.append(UInt64(symbolTableOffset))
+        buffer.append(UInt64(postingsOffset))
+        buffer.append(UInt64(stringsOffset))
+
+        for (record, name) in records {
+            try buffer.append(strings.intern(name))
+            try buffer.append(strings.intern(record.filePath))
+            buffer.append(record.isSystem ? USRIndexLayout.isSystemFlag : 0)
+            buffer.append(UInt32(0))
+        }
+
+        var firstPosting: UInt32 = 0
+        for index in order {
+            let symbol = symbols[index]
+            try buffer.append(strings.intern(symbol.usr))
+            try buffer.append(strings.intern(symbol.name))
+            buffer.append(symbol.kind.rawValue)
+            buffer.append(symbol.subKind.rawValue)
+            buffer.append(symbol.language.rawValue)
+            buffer.append(firstPosting)
+            buffer.append(UInt32(postings[index].count))
+            buffer.append(UInt32(0))
+            firstPosting += UInt32(postings[index].count)
+        }
+
+        for index in order {
+            let sorted = postings[index].sorted {
+                ($0.record, $0.line, $0.column, $0.roles) < ($1.record, $1.line, $1.column, $1.roles)
+            }
+            for posting in sorted {
+                buffer.append(posting.record)
+                buffer.append(posting.line)
+                buffer.append(posting.column)
+                buffer.append(UInt32(0))
+                buffer.append(posting.roles)
+            }
+        }
+
+        assert(buffer.count == stringsOffset)
+        buffer.append(contentsOf: strings.bytes)
+        return buffer.data
+    }
+}
+
+private struct StringTable {
+    private(set) var bytes: [UInt8] = []
+    private var offsets: [String: UInt32] = [:]
+
+    /// Returns the offset and length of `string`, storing it once.
+    mutating func intern(_ string: String?) throws -> (offset: UInt32, length: UInt32) {
+        guard let string else { return (0, USRIndexLayout.nullString) }
+        let length = string.utf8.count
+        if let offset = offsets[string] {
+            return (offset, UInt32(length))
+        }
+        guard bytes.count + length < Int(USRIndexLayout.nullString) else {
+            throw IndexStoreError.internalError("USR index strings exceed 4 GiB")
+        }
+        let offset = UInt32(bytes.count)
+        bytes.append(contentsOf: string.utf8)
+        offsets[string] = offset
+        return (offset, UInt32(length))
+    }
+}
+
+private struct BinaryBuffer {
+    private(set) var bytes: [UInt8] = []
+
+    var count: Int {
+        bytes.count
+    }
+
+    var data: Data {
+        Data(bytes)
+    }
+
+    mutating func reserveCapacity(_ capacity: Int) {
+        bytes.reserveCapacity(capacity)
+    }
+
+    mutating func append<T: FixedWidthInteger>(_ value: T) {
+        withUnsafeBytes(of: value.littleEndian) { bytes.append(contentsOf: $0) }
+    }
+
+    mutating func append(_ string: (offset: UInt32, length: UInt32)) {
+        append(string.offset)
+        append(string.length)
+    }
+
+    mutating func append(contentsOf other: [UInt8]) {
+        bytes.append(contentsOf: other)
+    }
+}
@@ -0,0 +1,315 @@
+import Foundation
+
+/// A persistent inverted index from symbol USRs to their occurrences.
+///
+/// The index file is memory mapped: opening it only validates the header, and
+/// lookups binary search a table of USRs sorted by their bytes without
+/// touching libIndexStore. Build or refresh it with
+/// `build(from:at:previous:includeSystem:workerCount:)`.
+public final class IndexStoreUSRIndex {
+
+    public struct Record: Hashable {
+        public let name: String
+        public let path: String?
+        public let isSystem: Bool
+    }
+
+    public struct Symbol: Hashable {
+        public let usr: String
+        public let name: String?
+        public let kind: IndexStoreSymbol.Kind
+        public let subKind: IndexStoreSymbol.SubKind
+        public let language: IndexStoreSymbol.Language
+    }
+
+    public struct Occurrence: Equatable {
+        public let record: Record
+        public let line: Int64
+        public let column: Int64
+        public let roles: IndexStoreOccurrence.Role
+    }
+
+    public let url: URL
+    /// The libIndexStore format version of the store the index was built from.
+    public let formatVersion: Int
+    /// Whether records of system units were indexed.
+    public let includesSystem: Bool
+    public let recordCount: Int
+    public let symbolCount: Int
+    public let occurrenceCount: Int
+
+    private let data: NSData
+    private let base: UnsafeRawPointer
+    private let layout: USRIndexLayout
+
+    /// Maps the index file at `url`. Throws if it is not an index file or was
+    /// written by an incompatible version of this library.
+    public static func open(at url: URL) throws -> IndexStoreUSRIndex {
+        try IndexStoreUSRIndex(url: url, data: NSData(contentsOf: url, options: .alwaysMapped))
+    }
+
+    private init(url: URL, data: NSData) throws {
+        let base = data.bytes
+        guard data.length >= USRIndexLayout.headerSize,
+              Self.load(UInt64.self, base, 0) == USRIndexLayout.magic else {
+            throw IndexStoreError.invalidIndexFile(url, "not an USR index")
+        }
+        guard Self.load(UInt32.self, base, 8) == USRIndexLayout.version else {
+            throw IndexStoreError.invalidIndexFile(url, "unsupported version")
+        }
+        let layout = USRIndexLayout(
+            recordCount: Int(Self.load(UInt32.self, base, 20)),
+            symbolCount: Int(Self.load(UInt32.self, base, 24)),
+            postingCount: Int(clamping: Self.load(UInt64.self, base, 32)),
+            recordTableOffset: Int(clamping: Self.load(UInt64.self, base, 40)),
+            symbolTableOffset: Int(clamping: Self.load(UInt64.self, base, 48)),
+            postingsOffset: Int(clamping: Self.load(UInt64.self, base, 56)),
+            stringsOffset: Int(clamping: Self.load(UInt64.self, base, 64)),
+            fileSize: data.length
+        )
+        guard layout.isValid else {
+            throw IndexStoreError.invalidIndexFile(url, "truncated")
+        }
+        self.url = url
+        self.data = data
+        self.base = base
+        self.layout = layout
+        self.formatVersion = Int(Self.load(UInt32.self, base, 12))
+        self.includesSystem = Self.load(UInt32.self, base, 16) & USRIndexLayout.includesSystemFlag != 0
+        self.recordCount = layout.recordCount
+        self.symbolCount = layout.symbolCount
+        self.occurrenceCount = layout.postingCount
+    }
+
+    public var records: [Record] {
+        (0..<recordCount).map(record(at:))
+    }
+
+    /// `nil` also when the symbol's kind, sub-kind or language is unknown to
+    /// this library, e.g. in a damaged file or one written by a newer version.
+    public func symbol(forUSR usr: String) -> Symbol? {
+        symbolIndex(of: usr).flatMap { symbol(at: $0) }
+    }
+
+    /// Visits the occurrences of `usr` having at least one of `roles`, ordered
+    /// by record, line and column.
+    public func forEachOccurrences(
+        ofUSR usr: String,
+        roles: IndexStoreOccurrence.Role? = nil,
+        _ next: (Occurrence) throws -> Bool
+    ) rethrows {
+        guard let index = symbolIndex(of: usr) else { return }
+        try forEachPosting(ofSymbolAt: index) { record, line, column, rawRoles in
+            let occurrenceRoles = IndexStoreOccurrence.Role(rawValue: rawRoles)
+            if let roles, occurrenceRoles.isDisjoint(with: roles) {
+                return true
+            }
+            return try next(Occurrence(
+                record: self.record(at: record),
+                line: Int64(line),
+                column: Int64(column),
+                roles: occurrenceRoles
+            ))
+        }
+    }
+
+    public func occurrences(ofUSR usr: String, roles: IndexStoreOccurrence.Role? = nil) -> [Occurrence] {
+        var result: [Occurrence] = []
+        forEachOccurrences(ofUSR: usr, roles: roles) {
+            result.append($0)
+            return true
+        }
+        return result
+    }
+
+    public func definitions(ofUSR usr: String) -> [Occurrence] {
+        occurrences(ofUSR: usr, roles: .definition)
+    }
+
+    public func references(ofUSR usr: String) -> [Occurrence] {
+        occurrences(ofUSR: usr, roles: .reference)
+    }
+
+    /// Whether the index still describes every distinct record of `store`.
+    /// Records are content addressed, so any changed source file shows up as
+    /// a different record name.
+    public func isUpToDate(with store: IndexStore) throws -> Bool {
+        guard formatVersion == Int(store.lib.format_version()) else { return false }
+        let ownership = try store.recordOwnership(includeSystem: includesSystem)
+        guard ownership.records.count == recordCount else { return false }
+        let indexed = Set((0..<recordCount).map { recordName(at: $0) })
+        return ownership.records.allSatisfy { entry in
+            entry.record.name.map { indexed.contains($0) } ?? true
+        }
+    }
+
+    // - MARK: Private
+
+    func record(at index: Int) -> Record {
+        let entry = layout.recordEntry(index)
+        return Record(
+            name: recordName(at: index),
+            path: string(at: entry + 8),
+            isSystem: uint32(entry + 16) & USRIndexLayout.isSystemFlag != 0
+        )
+    }
+
+    func recordName(at index: Int) -> String {
+        string(at: layout.recordEntry(index)) ?? ""
+    }
+
+    /// `nil` if the stored kind, sub-kind or language is unknown.
+    func symbol(at index: Int) -> Symbol? {
+        let entry = layout.symbolEntry(index)
+        guard let kind = IndexStoreSymbol.Kind(rawValue: uint32(entry + 16)),
+              let subKind = IndexStoreSymbol.SubKind(rawValue: uint32(entry + 20)),
+              let language = IndexStoreSymbol.Language(rawValue: uint32(entry + 24)) else {
+            return nil
+        }
+        return Symbol(
+            usr: string(at: entry) ?? "",
+            name: string(at: entry + 8),
+            kind: kind,
+            subKind: subKind,
+            language: language
+        )
+    }
+
+    /// Calls `body` with the record index, line, column and roles of each
+    /// posting of the symbol at `index`.
+    func forEachPosting(
+        ofSymbolAt index: Int,
+        _ body: (Int, UInt32, UInt32, UInt64) throws -> Bool
+    ) rethrows {
+        let entry = layout.symbolEntry(index)
+        let first = Int(uint32(entry + 28))
+        let end = min(first + Int(uint32(entry + 32)), layout.postingCount)
+        for posting in first..<max(first, end) {
+            let offset = layout.posting(posting)
+            let record = Int(uint32(offset))
+            guard record < recordCount else { continue }
+            guard try body(record, uint32(offset + 4), uint32(offset + 8), uint64(offset + 16)) else { break }
+        }
+    }
+
+    private func symbolIndex(of usr: String) -> Int? {
+        usr.withUTF8Bytes { key in
+            var low = 0
+            var high = symbolCount
+            while low < high {
+                let mid = (low + high) / 2
+                let order = Self.compare(bytes(at: layout.symbolEntry(mid)), key)
+                if order < 0 {
+                    low = mid + 1
+                } else if order > 0 {
+                    high = mid
+                } else {
+                    return mid
+                }
+            }
+            return nil
+        }
+    }
+
+    /// Reads the string whose offset and length are stored at `offset`.
+    private func string(at offset: Int) -> String? {
+        let length = uint32(offset + 4)
+        guard length != USRIndexLayout.nullString else { return nil }
+        return String(decoding: bytes(at: offset), as: UTF8.self)
+    }
+
+    private func bytes(at offset: Int) -> UnsafeRawBufferPointer {
+        let start = Int(uint32(offset))
+        var length = Int(uint32(offset + 4))
+        if length == Int(USRIndexLayout.nullString) || start + length > layout.stringsLength {
+            length = 0
+        }
+        return UnsafeRawBufferPointer(start: base + layout.stringsOffset + start, count: length)
+    }
+
+    private func uint32(_ offset: Int) -> UInt32 {
+        Self.load(UInt32.self, base, offset)
+    }
+
+    private func uint64(_ offset: Int) -> UInt64 {
+        Self.load(UInt64.self, base, offset)
+    }
+
+    private static func load<T: FixedWidthInteger>(_: T.Type, _ base: UnsafeRawPointer, _ offset: Int) -> T {
+        T(littleEndian: base.load(fromByteOffset: offset, as: T.self))
+    }
+
+    /// Orders byte strings like `memcmp`, shorter strings first on a tie.
+    static func compare(_ lhs: UnsafeRawBufferPointer, _ rhs: UnsafeRawBufferPointer) -> Int {
+        let common = min(lhs.count, rhs.count)
+        if common > 0 {
+            let order = memcmp(lhs.baseAddress!, rhs.baseAddress!, common)
+            if order != 0 { return Int(order) }
+        }
+        return lhs.count - rhs.count
+    }
+}
+
+/// Byte layout of an index file. All integers are little endian and all
+/// tables are 8-byte aligned.
+///
+///     header       72 bytes: magic, version, format version, flags,
+///                  record count, symbol count, reserved, posting count and
+///                  the offsets of the four sections below
+///     records      24 bytes each: name, path, flags, reserved
+///     symbols      40 bytes each: usr, name, kind, sub-kind, language,
+///                  first posting, posting count, reserved; sorted by usr
+///     postings     24 bytes each: record, line, column, reserved, roles
+///     strings      UTF-8 bytes
+///
+/// Strings are stored as a 32-bit offset into the strings section followed by
+/// a 32-bit length, `nullString` for `nil`.
+struct USRIndexLayout {
+    static let magic: UInt64 = 0x5844_4e49_5253_5553 // "SUSRINDX"
+    static let version: UInt32 = 1
+    static let headerSize = 72
+    static let recordEntrySize = 24
+    static let symbolEntrySize = 40
+    static let postingSize = 24
+    static let nullString = UInt32.max
+    static let includesSystemFlag: UInt32 = 1
+    static let isSystemFlag: UInt32 = 1
+
+    let recordCount: Int
+    let symbolCount: Int
+    let postingCount: Int
+    let recordTableOffset: Int
+    let symbolTableOffset: Int
+    let postingsOffset: Int
+    let stringsOffset: Int
+    let fileSize: Int
+
+    var stringsLength: Int {
+        fileSize - stringsOffset
+    }
+
+    var isValid: Bool {
+        guard Self.headerSize <= recordTableOffset,
+              recordTableOffset <= symbolTableOffset,
+              symbolTableOffset <= postingsOffset,
+              postingsOffset <= stringsOffset,
+              stringsOffset <= fileSize,
+              postingCount <= fileSize / Self.postingSize
+        else { return false }
+        return recordTableOffset + recordCount * Self.recordEntrySize <= symbolTableOffset
+            && symbolTableOffset + symbolCount * Self.symbolEntrySize <= postingsOffset
+            && postingsOffset + postingCount * Self.postingSize <= stringsOffset
+    }
+
+    func recordEntry(_ index: Int) -> Int {
+        recordTableOffset + index * Self.recordEntrySize
+    }
+
+    func symbolEntry(_ index: Int) -> Int {
+        symbolTableOffset + index * Self.symbolEntrySize
+    }
+
+    func posting(_ index: Int) -> Int {
+        postingsOffset + index * Self.postingSize
+    }
+}
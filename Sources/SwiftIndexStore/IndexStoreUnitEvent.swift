@@ -0,0 +1,221 @@
+import _CIndexStore
+import Foundation
+
+public struct IndexStoreUnitEvent: Equatable {
+    public enum Kind: Equatable {
+        case added
+        case removed
+        case modified
+        /// The units directory itself was removed.
+        case directoryDeleted
+
+        init?(_ kind: indexstore_unit_event_kind_t) {
+            switch kind {
+            case INDEXSTORE_UNIT_EVENT_ADDED: self = .added
+            case INDEXSTORE_UNIT_EVENT_REMOVED: self = .removed
+            case INDEXSTORE_UNIT_EVENT_MODIFIED: self = .modified
+            case INDEXSTORE_UNIT_EVENT_DIRECTORY_DELETED: self = .directoryDeleted
+            default: return nil
+            }
+        }
+    }
+
+    public let kind: Kind
+    public let unit: IndexStoreUnit
+
+    public init(kind: Kind, unit: IndexStoreUnit) {
+        self.kind = kind
+        self.unit = unit
+    }
+}
+
+public struct IndexStoreUnitEventNotification {
+    /// `true` for the notification reporting the units already in the store
+    /// when listening started.
+    public let isInitial: Bool
+    public let events: [IndexStoreUnitEvent]
+}
+
+extension IndexStore {
+
+    /// Starts reporting units added to, removed from or modified in the store.
+    ///
+    /// The first notification has `isInitial` set and reports every existing
+    /// unit as added. If libIndexStore can't watch the store directory on this
+    /// platform, the units directory is polled every `pollingInterval` seconds
+    /// instead. `handler` is called on a background queue. Live events also
+    /// invalidate the cached path to record map and the cached readers of
+    /// the units they report.
+    public func startUnitEventListening(
+        waitInitialSync: Bool = true,
+        pollingInterval: TimeInterval = 1,
+        _ handler: @escaping (IndexStoreUnitEventNotification) -> Void
+    ) {
+        stopUnitEventListening()
+
+        let notify: (IndexStoreUnitEventNotification) -> Void = { [weak self] notification in
+            if !notification.isInitial {
+                if notification.events.contains(where: { $0.kind == .directoryDeleted }) {
+                    self?.invalidateUnitReaders()
+                } else {
+                    self?.invalidateUnitReaders(for: notification.events.map(\.unit))
+                }
+                self?.invalidateRecordPathMap()
+            }
+            handler(notification)
+        }
+        // Without the event entry points, fall back to polling as below.
+        guard (try? lib.bind(.unitEvents)) != nil else {
+            startPolling(waitInitialSync: waitInitialSync, pollingInterval: pollingInterval, notify)
+            return
+        }
+        let listener = UnitEventListener(lib: lib, handler: notify)
+        lib.store_set_unit_event_handler_f(
+            store,
+            Unmanaged.passRetained(listener).toOpaque(),
+            { ctx, notification in
+                let listener = Unmanaged<UnitEventListener>.fromOpaque(ctx!).takeUnretainedValue()
+                listener.receive(notification)
+            },
+            { ctx in
+                Unmanaged<UnitEventListener>.fromOpaque(ctx!).release()
+            }
+        )
+
+        var options = indexstore_unit_event_listen_options_t(wait_initial_sync: waitInitialSync)
+        let failed = (try? lib.throwsfy({
+            lib.store_start_unit_event_listening(
+                store, &options, MemoryLayout<indexstore_unit_event_listen_options_t>.size, &$0
+            )
+        })) ?? true
+        guard failed else { return }
+
+        // libIndexStore is built without a directory watcher on this platform.
+        startPolling(waitInitialSync: waitInitialSync, pollingInterval: pollingInterval, notify)
+    }
+
+    private func startPolling(
+        waitInitialSync: Bool,
+        pollingInterval: TimeInterval,
+        _ notify: @escaping (IndexStoreUnitEventNotification) -> Void
+    ) {
+        let poller = UnitEventPoller(store: self, handler: notify)
+        unitEventLock.perform { unitEventPoller = poller }
+        poller.start(waitInitialSync: waitInitialSync, interval: pollingInterval)
+    }
+
+    public func stopUnitEventListening() {
+        // Nothing can be listening before the event entry points are bound.
+        if lib.isBound(.unitEvents) {
+            lib.store_stop_unit_event_listening(store)
+        }
+        let poller = unitEventLock.perform { () -> UnitEventPoller? in
+            defer { unitEventPoller = nil }
+            return unitEventPoller
+        }
+        poller?.stop()
+    }
+}
+
+/// Converts libIndexStore notifications. Owned by libIndexStore through the
+/// handler context and released by the handler finalizer.
+final class UnitEventListener {
+    let lib: LibIndexStore
+    let handler: (IndexStoreUnitEventNotification) -> Void
+
+    init(lib: LibIndexStore, handler: @escaping (IndexStoreUnitEventNotification) -> Void) {
+        self.lib = lib
+        self.handler = handler
+    }
+
+    func receive(_ notification: indexstore_unit_event_notification_t?) {
+        let count = lib.unit_event_notification_get_events_count(notification)
+        var events: [IndexStoreUnitEvent] = []
+        events.reserveCapacity(count)
+        for index in 0..<count {
+            let event = lib.unit_event_notification_get_event(notification, index)
+            guard let kind = IndexStoreUnitEvent.Kind(lib.unit_event_get_kind(event)) else { continue }
+            let unit = IndexStoreUnit(name: lib.unit_event_get_unit_name(event).toSwiftString())
+            events.append(IndexStoreUnitEvent(kind: kind, unit: unit))
+        }
+        handler(IndexStoreUnitEventNotification(
+            isInitial: lib.unit_event_notification_is_initial(notification),
+            events: events
+        ))
+    }
+}
+
+/// Reports unit events by periodically diffing the unit modification times.
+final class UnitEventPoller {
+    private weak var store: IndexStore?
+    private let handler: (IndexStoreUnitEventNotification) -> Void
+    private let queue = DispatchQueue(label: "SwiftIndexStore.UnitEventPoller")
+    private let lock = UnfairLock()
+    private var timer: DispatchSourceTimer?
+    private var isStopped = false
+    /// Only accessed on `queue`.
+    private var snapshot: [IndexStoreUnit: IndexStoreModificationTime] = [:]
+
+    init(store: IndexStore, handler: @escaping (IndexStoreUnitEventNotification) -> Void) {
+        self.store = store
+        self.handler = handler
+    }
+
+    func start(waitInitialSync: Bool, interval: TimeInterval) {
+        if waitInitialSync {
+            queue.sync { poll(isInitial: true) }
+        } else {
+            queue.async { self.poll(isInitial: true) }
+        }
+        lock.perform {
+            guard !isStopped else { return }
+            let timer = DispatchSource.makeTimerSource(queue: queue)
+            timer.schedule(deadline: .now() + interval, repeating: interval)
+            timer.setEventHandler { [weak self] in
+                self?.poll(isInitial: false)
+            }
+            timer.resume()
+            self.timer = timer
+        }
+    }
+
+    func stop() {
+        lock.perform {
+            isStopped = true
+            timer?.cancel()
+            timer = nil
+        }
+    }
+
+    private func poll(isInitial: Bool) {
+        guard let store else {
+            stop()
+            return
+        }
+        var current: [IndexStoreUnit: IndexStoreModificationTime] = [:]
+        for unit in store.units() {
+            // A unit removed between listing and stat is reported on the next poll.
+            guard let modificationTime = try? store.modificationTime(for: unit) else { continue }
+            current[unit] = modificationTime
+        }
+
+        var events: [IndexStoreUnitEvent] = []
+        for (unit, modificationTime) in current {
+            if let previous = snapshot[unit] {
+                if previous != modificationTime {
+                    events.append(IndexStoreUnitEvent(kind: .modified, unit: unit))
+                }
+            } else {
+                events.append(IndexStoreUnitEvent(kind: .added, unit: unit))
+            }
+        }
+        for unit in snapshot.keys where current[unit] == nil {
+            events.append(IndexStoreUnitEvent(kind: .removed, unit: unit))
+        }
+        snapshot = current
+
+        if isInitial || !events.isEmpty {
+            handler(IndexStoreUnitEventNotification(isInitial: isInitial, events: events))
+        }
+    }
+}
@@ -0,0 +1,207 @@
+import Foundation
+
+/// Unit, record and file dependencies of every unit of a store, with
+/// transitive queries.
+///
+/// Edges are kept in compressed sparse row form. Transitive closures are
+/// cached, so repeated queries don't walk the graph again. Queries are
+/// thread-safe.
+public final class IndexStoreUnitGraph {
+
+    public let units: [IndexStoreUnit]
+    /// Paths of every source file and record file units depend on.
+    public let files: [String]
+    /// Names of every record units depend on.
+    public let records: [String]
+
+    private let unitIndices: [String: Int32]
+    private let fileIndices: [String: Int32]
+    private let recordIndices: [String: Int32]
+
+    /// Unit to the units it imports.
+    let unitDependencies: CompressedAdjacency
+    /// Unit to the units importing it.
+    let unitDependents: CompressedAdjacency
+    /// File to the units depending on it directly.
+    let fileDependents: CompressedAdjacency
+    /// Record to the units depending on it directly.
+    let recordDependents: CompressedAdjacency
+
+    private let lock = UnfairLock()
+    private var dependentClosures: [Int32: [Int32]] = [:]
+    private var dependencyClosures: [Int32: [Int32]] = [:]
+
+    init(
+        units: [IndexStoreUnit],
+        unitEdges: [(Int32, Int32)],
+        files: [String],
+        fileEdges: [(Int32, Int32)],
+        records: [String],
+        recordEdges: [(Int32, Int32)]
+    ) {
+        self.units = units
+        self.files = files
+        self.records = records
+        self.unitIndices = Self.indices(of: units.map { $0.name ?? "" })
+        self.fileIndices = Self.indices(of: files)
+        self.recordIndices = Self.indices(of: records)
+        self.unitDependencies = CompressedAdjacency(nodeCount: units.count, edges: unitEdges)
+        self.unitDependents = CompressedAdjacency(nodeCount: units.count, edges: unitEdges.map { ($1, $0) })
+        self.fileDependents = CompressedAdjacency(nodeCount: files.count, edges: fileEdges.map { ($1, $0) })
+        self.recordDependents = CompressedAdjacency(nodeCount: records.count, edges: recordEdges.map { ($1, $0) })
+    }
+
+    public var edgeCount: Int {
+        unitDependencies.edgeCount + fileDependents.edgeCount + recordDependents.edgeCount
+    }
+
+    /// Units imported by `unit`, directly or not.
+    public func dependencies(of unit: IndexStoreUnit, transitive: Bool = true) -> [IndexStoreUnit] {
+        guard let index = unit.name.flatMap({ unitIndices[$0] }) else { return [] }
+        guard transitive else { return unitDependencies[Int(index)].map { units[Int($0)] } }
+        return closure(from: [index], in: unitDependencies, cache: \.dependencyClosures)
+            .filter { $0 != index }
+            .map { units[Int($0)] }
+    }
+
+    /// Units importing `unit`, directly or not.
+    public func dependents(of unit: IndexStoreUnit, transitive: Bool = true) -> [IndexStoreUnit] {
+        guard let index = unit.name.flatMap({ unitIndices[$0] }) else { return [] }
+        guard transitive else { return unitDependents[Int(index)].map { units[Int($0)] } }
+        return closure(from: [index], in: unitDependents, cache: \.dependentClosures)
+            .filter { $0 != index }
+            .map { units[Int($0)] }
+    }
+
+    /// Units depending on the file at `path`, directly or through the units
+    /// they import.
+    public func units(dependingOnFile path: String) -> [IndexStoreUnit] {
+        affectedUnits(changedFiles: [path])
+    }
+
+    /// Units depending on the record named `name`, directly or through the
+    /// units they import.
+    public func units(dependingOnRecord name: String) -> [IndexStoreUnit] {
+        guard let record = recordIndices[name] else { return [] }
+        let direct = recordDependents[Int(record)]
+        return closure(from: Array(direct), in: unitDependents, cache: \.dependentClosures).map { units[Int($0)] }
+    }
+
+    /// Every unit that must be reanalyzed when the files at `paths` change,
+    /// sorted in store order.
+    public func affectedUnits(changedFiles paths: [String]) -> [IndexStoreUnit] {
+        var direct: [Int32] = []
+        for path in paths {
+            guard let file = fileIndices[path] else { continue }
+            direct.append(contentsOf: fileDependents[Int(file)])
+        }
+        return closure(from: direct, in: unitDependents, cache: \.dependentClosures).map { units[Int($0)] }
+    }
+
+    // - MARK: Private
+
+    /// The nodes reachable from `sources`, sources included, sorted.
+    private func closure(
+        from sources: [Int32],
+        in adjacency: CompressedAdjacency,
+        cache: ReferenceWritableKeyPath<IndexStoreUnitGraph, [Int32: [Int32]]>
+    ) -> [Int32] {
+        var reached = [Bool](repeating: false, count: units.count)
+        for source in sources where !reached[Int(source)] {
+            let nodes: [Int32]
+            if let cached = lock.perform({ self[keyPath: cache][source] }) {
+                nodes = cached
+            } else {
+                nodes = adjacency.reachable(from: source)
+                lock.perform { self[keyPath: cache][source] = nodes }
+            }
+            for node in nodes {
+                reached[Int(node)] = true
+            }
+        }
+        return reached.indices.compactMap { reached[$0] ? Int32($0) : nil }
+    }
+
+    private static func indices(of names: [String]) -> [String: Int32] {
+        var indices: [String: Int32] = [:]
+        indices.reserveCapacity(names.count)
+        for (index, name) in names.enumerated() where indices[name] == nil {
+            indices[name] = Int32(index)
+        }
+        return indices
+    }
+}
+
+extension IndexStore {
+
+    /// Reads the dependencies of every unit on a pool of `workerCount` workers
+    /// and builds their graph.
+    public func unitGraph(
+        includeSystem: Bool = true,
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> IndexStoreUnitGraph {
+        typealias Dependencies = (units: [String], files: [String], records: [(name: String, path: String?)])
+        let perUnit = try concurrentMapUnits(includeSystem: includeSystem, workerCount: workerCount) { unit -> (IndexStoreUnit, Dependencies) in
+            var dependencies: Dependencies = ([], [], [])
+            try forEachRecordDependencies(for: unit) { dependency in
+                switch dependency {
+                case .unit(let dependencyUnit):
+                    if let name = dependencyUnit.name { dependencies.units.append(name) }
+                case .file(let file):
+                    if let path = file.filePath { dependencies.files.append(path) }
+                case .record(let record):
+                    if let name = record.name { dependencies.records.append((name, record.filePath)) }
+                }
+                return true
+            }
+            return (unit, dependencies)
+        }
+
+        let units = perUnit.map { $0.0 }
+        var unitIndices: [String: Int32] = [:]
+        for (index, unit) in units.enumerated() {
+            if let name = unit.name { unitIndices[name] = Int32(index) }
+        }
+        var files: [String] = []
+        var fileIndices: [String: Int32] = [:]
+        var records: [String] = []
+        var recordIndices: [String: Int32] = [:]
+        func intern(_ name: String, in names: inout [String], _ indices: inout [String: Int32]) -> Int32 {
+            if let index = indices[name] { return index }
+            let index = Int32(names.count)
+            names.append(name)
+            indices[name] = index
+            return index
+        }
+
+        var unitEdges: [(Int32, Int32)] = []
+        var fileEdges: [(Int32, Int32)] = []
+        var recordEdges: [(Int32, Int32)] = []
+        for (source, (_, dependencies)) in perUnit.enumerated() {
+            let source = Int32(source)
+            for name in dependencies.units {
+                // Units of other stores or excluded system units have no node.
+                guard let target = unitIndices[name] else { continue }
+                unitEdges.append((source, target))
+            }
+            for path in dependencies.files {
+                fileEdges.append((source, intern(path, in: &files, &fileIndices)))
+            }
+            for record in dependencies.records {
+                recordEdges.append((source, intern(record.name, in: &records, &recordIndices)))
+                if let path = record.path {
+                    fileEdges.append((source, intern(path, in: &files, &fileIndices)))
+                }
+            }
+        }
+
+        return IndexStoreUnitGraph(
+            units: units,
+            unitEdges: unitEdges,
+            files: files,
+            fileEdges: fileEdges,
+            records: records,
+            recordEdges: recordEdges
+        )
+    }
+}
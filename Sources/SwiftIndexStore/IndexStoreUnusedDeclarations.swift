@@ -0,0 +1,305 @@
+import Foundation
+
+/// A declaration defined in the store and never referenced.
+public struct IndexStoreUnusedDeclaration: Hashable {
+    public var usr: String
+    public var name: String
+    public var kind: IndexStoreSymbol.Kind
+    public var subKind: IndexStoreSymbol.SubKind
+    public var path: String?
+    public var line: Int64
+    public var column: Int64
+
+    public init(
+        usr: String,
+        name: String,
+        kind: IndexStoreSymbol.Kind,
+        subKind: IndexStoreSymbol.SubKind,
+        path: String?,
+        line: Int64,
+        column: Int64
+    ) {
+        self.usr = usr
+        self.name = name
+        self.kind = kind
+        self.subKind = subKind
+        self.path = path
+        self.line = line
+        self.column = column
+    }
+}
+
+public struct IndexStoreUnusedDeclarationOptions {
+    /// Kinds never reported. Extensions and modules can't be referenced.
+    public var ignoredKinds: Set<IndexStoreSymbol.Kind>
+    /// Whether references the compiler synthesized, such as those of derived
+    /// `Codable` conformances, keep a declaration alive.
+    public var countsImplicitReferences: Bool
+    public var includeSystem: Bool
+
+    public init(
+        ignoredKinds: Set<IndexStoreSymbol.Kind> = [.unknown, .module, .namespace, .extension, .parameter],
+        countsImplicitReferences: Bool = true,
+        includeSystem: Bool = false
+    ) {
+        self.ignoredKinds = ignoredKinds
+        self.countsImplicitReferences = countsImplicitReferences
+        self.includeSystem = includeSystem
+    }
+}
+
+extension IndexStore {
+
+    /// Finds the declarations of the store that nothing references.
+    ///
+    /// Records are scanned once on a pool of `workerCount` workers, with USRs
+    /// interned, and the results are merged afterwards. A declaration counts
+    /// as used when:
+    /// - it is referenced from outside its own body and its enclosing type,
+    ///   or from a used declaration inside that type, so that members only
+    ///   referencing each other are unused;
+    /// - it overrides, or witnesses, a declaration that is dynamically
+    ///   referenced or declared outside the scanned records;
+    /// - one of its accessors is used.
+    ///
+    /// Implicit declarations are never reported, and members of an unused
+    /// declaration are folded into it, extensions into the type they extend.
+    public func unusedDeclarations(
+        options: IndexStoreUnusedDeclarationOptions = .init(),
+        workerCount: Int = IndexStore.defaultWorkerCount
+    ) throws -> [IndexStoreUnusedDeclaration] {
+        let strings = IndexStoreStringInterner()
+        let filter = IndexStoreOccurrenceFilter(
+            roles: [.definition, .declaration, .reference],
+            includeSystem: options.includeSystem
+        )
+        let usages = try concurrentMapDistinctRecords(includeSystem: options.includeSystem, workerCount: workerCount) { entry in
+            try scanUsage(of: entry.record, matching: filter, options: options, strings: strings)
+        }
+
+        var definitions: [IndexStoreStringInterner.ID: DeclarationUsage.Definition] = [:]
+        var declared = Set<IndexStoreStringInterner.ID>()
+        var references: [DeclarationUsage.Reference] = []
+        var parents: [IndexStoreStringInterner.ID: IndexStoreStringInterner.ID] = [:]
+        var accessorOwners: [IndexStoreStringInterner.ID: IndexStoreStringInterner.ID] = [:]
+        var overriders: [IndexStoreStringInterner.ID: [IndexStoreStringInterner.ID]] = [:]
+        for usage in usages {
+            for definition in usage.definitions where definitions[definition.usr] == nil {
+                definitions[definition.usr] = definition
+            }
+            declared.formUnion(usage.declarations)
+            references.append(contentsOf: usage.references)
+            for (child, parent) in usage.parents where parents[child] == nil {
+                parents[child] = parent
+            }
+            for (accessor, owner) in usage.accessors {
+                accessorOwners[accessor] = owner
+            }
+            for (overrider, base) in usage.overrides {
+                overriders[base, default: []].append(overrider)
+            }
+        }
+
+        var ownerAccessors: [IndexStoreStringInterner.ID: [IndexStoreStringInterner.ID]] = [:]
+        for (accessor, owner) in accessorOwners {
+            ownerAccessors[owner, default: []].append(accessor)
+        }
+
+        /// The closest type or extended type `usr` is declared in.
+        func enclosingType(of usr: IndexStoreStringInterner.ID) -> IndexStoreStringInterner.ID? {
+            var ancestor = parents[usr]
+            while let current = ancestor {
+                // Types outside the scanned records can only be extended.
+                guard let kind = definitions[current]?.kind else { return current }
+                if [.class, .struct, .enum, .protocol].contains(kind) {
+                    return current
+                }
+                ancestor = parents[current]
+            }
+            return nil
+        }
+
+        func isDeclared(_ usr: IndexStoreStringInterner.ID, in type: IndexStoreStringInterner.ID) -> Bool {
+            var ancestor: IndexStoreStringInterner.ID? = usr
+            while let current = ancestor {
+                if current == type {
+                    return true
+                }
+                ancestor = parents[current]
+            }
+            return false
+        }
+
+        // References from inside the type of the referenced declaration only
+        // count once the declaration containing them is used.
+        var used = Set<IndexStoreStringInterner.ID>()
+        var pending: [IndexStoreStringInterner.ID] = []
+        var dynamicallyUsed: [IndexStoreStringInterner.ID] = []
+        var internalReferences: [IndexStoreStringInterner.ID: [DeclarationUsage.Reference]] = [:]
+        func use(_ reference: DeclarationUsage.Reference) {
+            if used.insert(reference.usr).inserted {
+                pending.append(reference.usr)
+            }
+            if reference.isDynamic {
+                dynamicallyUsed.append(reference.usr)
+            }
+        }
+        for reference in references {
+            if let container = reference.container,
+               let type = enclosingType(of: reference.usr),
+               isDeclared(container, in: type) {
+                internalReferences[container, default: []].append(reference)
+            } else {
+                use(reference)
+            }
+        }
+
+        // A dynamic reference may dispatch to any override of its target, and
+        // declarations outside the store may call anything overriding theirs.
+        // Accessors and their property keep each other alive.
+        var overridden = Set<IndexStoreStringInterner.ID>()
+        dynamicallyUsed.append(contentsOf: overriders.keys.filter { !declared.contains($0) })
+        while !pending.isEmpty || !dynamicallyUsed.isEmpty {
+            while let base = dynamicallyUsed.popLast() {
+                guard overridden.insert(base).inserted else { continue }
+                for overrider in overriders[base] ?? [] {
+                    use(.init(usr: overrider, container: nil, isDynamic: true))
+                }
+            }
+            guard let usr = pending.popLast() else { continue }
+            for reference in internalReferences[usr] ?? [] {
+                use(reference)
+            }
+            var related = ownerAccessors[usr] ?? []
+            if let owner = accessorOwners[usr] {
+                related.append(owner)
+            }
+            for usr in related {
+                use(.init(usr: usr, container: nil, isDynamic: false))
+            }
+        }
+
+        func isReported(_ usr: IndexStoreStringInterner.ID) -> Bool {
+            guard !used.contains(usr), let definition = definitions[usr] else { return false }
+            return !options.ignoredKinds.contains(definition.kind) && accessorOwners[usr] == nil
+        }
+        var unused: [IndexStoreUnusedDeclaration] = []
+        for (usr, definition) in definitions where isReported(usr) {
+            var ancestor = parents[usr]
+            var isFolded = false
+            while let current = ancestor, !isFolded {
+                isFolded = isReported(current)
+                ancestor = parents[current]
+            }
+            guard !isFolded else { continue }
+            unused.append(IndexStoreUnusedDeclaration(
+                usr: strings.string(for: usr),
+                name: strings.string(for: definition.name),
+                kind: definition.kind,
+                subKind: definition.subKind,
+                path: definition.path,
+                line: definition.line,
+                column: definition.column
+            ))
+        }
+        return unused.sorted {
+            ($0.path ?? "", $0.line, $0.column, $0.usr) < ($1.path ?? "", $1.line, $1.column, $1.usr)
+        }
+    }
+
+    private func scanUsage(
+        of record: IndexStoreUnit.Dependency.Record,
+        matching filter: IndexStoreOccurrenceFilter,
+        options: IndexStoreUnusedDeclarationOptions,
+        strings: IndexStoreStringInterner
+    ) throws -> DeclarationUsage {
+        var usage = DeclarationUsage()
+        try forEachOccurrenceRefs(for: record, matching: filter) { occurrence in
+            let roles = occurrence.roles
+            let symbol = occurrence.symbol
+            guard !symbol.usr.isEmpty else { return true }
+            let usr = strings.intern(symbol.usr)
+
+            if !roles.isDisjoint(with: [.definition, .declaration]) {
+                occurrence.forEachRelation { relationRoles, related in
+                    if !relationRoles.isDisjoint(with: [.childOf, .accessorOf]) {
+                        usage.parents.append((usr, strings.intern(related.usr)))
+                    }
+                    if relationRoles.contains(.accessorOf) {
+                        usage.accessors.append((usr, strings.intern(related.usr)))
+                    }
+                    if relationRoles.contains(.overrideOf) {
+                        usage.overrides.append((usr, strings.intern(related.usr)))
+                    }
+                    return true
+                }
+                usage.declarations.append(usr)
+                if roles.contains(.definition), !roles.contains(.implicit) {
+                    let location = occurrence.lineAndColumn
+                    usage.definitions.append(.init(
+                        usr: usr,
+                        name: strings.intern(symbol.name),
+                        kind: symbol.kind,
+                        subKind: symbol.subKind,
+                        path: record.filePath,
+                        line: location.line,
+                        column: location.column
+                    ))
+                }
+            }
+
+            if roles.contains(.reference), options.countsImplicitReferences || !roles.contains(.implicit) {
+                var isRecursive = false
+                var container: IndexStoreStringInterner.ID?
+                occurrence.forEachRelation { relationRoles, related in
+                    if relationRoles.contains(.extendedBy) {
+                        usage.parents.append((strings.intern(related.usr), usr))
+                    }
+                    if !relationRoles.isDisjoint(with: [.calledBy, .containedBy]) {
+                        if related.usr == symbol.usr {
+                            isRecursive = true
+                        } else if container == nil {
+                            container = strings.intern(related.usr)
+                        }
+                    }
+                    return true
+                }
+                guard !isRecursive else { return true }
+                usage.references.append(.init(usr: usr, container: container, isDynamic: roles.contains(.dynamic)))
+            }
+            return true
+        }
+        return usage
+    }
+}
+
+/// What one record defines and references.
+private struct DeclarationUsage {
+    struct Definition {
+        var usr: IndexStoreStringInterner.ID
+        var name: IndexStoreStringInterner.ID
+        var kind: IndexStoreSymbol.Kind
+        var subKind: IndexStoreSymbol.SubKind
+        var path: String?
+        var line: Int64
+        var column: Int64
+    }
+
+    struct Reference {
+        var usr: IndexStoreStringInterner.ID
+        /// The declaration the reference is made from, if any.
+        var container: IndexStoreStringInterner.ID?
+        var isDynamic: Bool
+    }
+
+    var definitions: [Definition] = []
+    /// Every symbol declared or defined by the record, implicit ones included.
+    var declarations: [IndexStoreStringInterner.ID] = []
+    var references: [Reference] = []
+    /// Child to container: members, accessors and extensions.
+    var parents: [(IndexStoreStringInterner.ID, IndexStoreStringInterner.ID)] = []
+    /// Accessor to its property.
+    var accessors: [(IndexStoreStringInterner.ID, IndexStoreStringInterner.ID)] = []
+    /// Overriding or witnessing member to the member it overrides.
+    var overrides: [(IndexStoreStringInterner.ID, IndexStoreStringInterner.ID)] = []
+}
@@ -4,76 +4,206 @@ import _CIndexStore
 @dynamicMemberLookup
 public class LibIndexStore {
 
+    /// Entry points that only some features use. They are resolved on first
+    /// use, so that opening the library binds only what every scan needs.
+    enum FunctionGroup: CaseIterable {
+        case unitEvents
+        case lineRange
+        case symbolSearch
+    }
+
     private let url: URL
-    private let api: indexstore_functions_t
+    private let dylib: UnsafeMutableRawPointer
+    /// Allocated once, so that lazily bound entry points can be filled in
+    /// while other threads read the rest.
+    private let api: UnsafeMutablePointer<indexstore_functions_t>
+    private let bindingLock = UnfairLock()
+    private var boundGroups: Set<FunctionGroup> = []
+    /// Names of the bound entry points without their `indexstore_` prefix,
+    /// keyed by their offset in `api`.
+    private var functionNames: [Int: String]
 
-    init(url: URL, api: indexstore_functions_t) {
+    private init(url: URL, dylib: UnsafeMutableRawPointer, binder: Binder) {
         self.url = url
-        self.api = api
+        self.dylib = dylib
+        self.api = binder.api
+        self.functionNames = binder.names
+    }
+
+    deinit {
+        api.deallocate()
     }
 
     func getPath() -> String { url.path }
 
     subscript<T>(dynamicMember keyPath: KeyPath<indexstore_functions_t, T>) -> T {
-        api[keyPath: keyPath]
+        if let instrumentation = IndexStoreInstrumentation.active {
+            instrumentation.recordCall(keyPath, lib: self)
+        }
+        return api.pointee[keyPath: keyPath]
     }
 
-    public static func open(url: URL) throws -> LibIndexStore {
-        typealias Dylib = UnsafeMutableRawPointer
+    func functionName(at offset: Int) -> String? {
+        bindingLock.perform { functionNames[offset] }
+    }
+
+    /// Resolves the entry points of `group` unless they already are. Call it
+    /// before using any of them.
+    func bind(_ group: FunctionGroup) throws {
+        try bindingLock.perform {
+            guard !boundGroups.contains(group) else { return }
+            var binder = Binder(dylib: dylib, api: api)
+            try Self.bind(group, with: &binder)
+            functionNames.merge(binder.names) { _, new in new }
+            boundGroups.insert(group)
+        }
+    }
+
+    func isBound(_ group: FunctionGroup) -> Bool {
+        bindingLock.perform { boundGroups.contains(group) }
+    }
+
+    private struct Binder {
+        let dylib: UnsafeMutableRawPointer
+        let api: UnsafeMutablePointer<indexstore_functions_t>
+        var names: [Int: String] = [:]
+
+        mutating func bind<T>(_ keyPath: WritableKeyPath<indexstore_functions_t, T>, _ symbol: String) throws {
+            guard let sym = dlsym(dylib, symbol) else {
+                throw IndexStoreError.missingSymbol(symbol)
+            }
+            api.pointee[keyPath: keyPath] = unsafeBitCast(sym, to: T.self)
+            names[MemoryLayout<indexstore_functions_t>.offset(of: keyPath)!] = String(symbol.dropFirst("indexstore_".count))
+        }
+    }
+
+    private static func bind(_ group: FunctionGroup, with binder: inout Binder) throws {
+        switch group {
+        case .unitEvents:
+            try binder.bind(\.store_set_unit_event_handler_f, "indexstore_store_set_unit_event_handler_f")
+            try binder.bind(\.store_start_unit_event_listening, "indexstore_store_start_unit_event_listening")
+            try binder.bind(\.store_stop_unit_event_listening, "indexstore_store_stop_unit_event_listening")
+            try binder.bind(\.unit_event_notification_get_events_count, "indexstore_unit_event_notification_get_events_count")
+            try binder.bind(\.unit_event_notification_get_event, "indexstore_unit_event_notification_get_event")
+            try binder.bind(\.unit_event_notification_is_initial, "indexstore_unit_event_notification_is_initial")
+            try binder.bind(\.unit_event_get_kind, "indexstore_unit_event_get_kind")
+            try binder.bind(\.unit_event_get_unit_name, "indexstore_unit_event_get_unit_name")
+        case .lineRange:
+            try binder.bind(\.record_reader_occurrences_in_line_range_apply_f, "indexstore_record_reader_occurrences_in_line_range_apply_f")
+        case .symbolSearch:
+            try binder.bind(\.record_reader_search_symbols_f, "indexstore_record_reader_search_symbols_f")
+        }
+    }
 
+    public static func open(url: URL) throws -> LibIndexStore {
         var flags = RTLD_LAZY | RTLD_LOCAL
 
         #if os(macOS)
             flags |= RTLD_FIRST
         #endif
 
-        let dylib = dlopen(url.path, flags)!
-        var api = indexstore_functions_t()
-        func requireSym<T>(_ dylib: Dylib, _ symbol: String) throws -> T {
-            guard let sym = dlsym(dylib, symbol) else {
-                throw IndexStoreError.missingSymbol(symbol)
+        guard let dylib = dlopen(url.path, flags) else {
+            throw IndexStoreError.unableLoadLibrary(url, dlerror().map { String(cString: $0) } ?? "unknown error")
+        }
+        let api = UnsafeMutablePointer<indexstore_functions_t>.allocate(capacity: 1)
+        api.initialize(to: indexstore_functions_t())
+        var binder = Binder(dylib: dylib, api: api)
+        do {
+            try binder.bind(\.format_version, "indexstore_format_version")
+            try binder.bind(\.store_create, "indexstore_store_create")
+            try binder.bind(\.store_dispose, "indexstore_store_dispose")
+            try binder.bind(\.store_units_apply_f, "indexstore_store_units_apply_f")
+            try binder.bind(\.store_get_unit_modification_time, "indexstore_store_get_unit_modification_time")
+            try binder.bind(\.unit_reader_dependencies_apply_f, "indexstore_unit_reader_dependencies_apply_f")
+            try binder.bind(\.unit_reader_is_system_unit, "indexstore_unit_reader_is_system_unit")
+            try binder.bind(\.unit_dependency_get_kind, "indexstore_unit_dependency_get_kind")
+            try binder.bind(\.unit_reader_create, "indexstore_unit_reader_create")
+            try binder.bind(\.unit_reader_dispose, "indexstore_unit_reader_dispose")
+            try binder.bind(\.unit_reader_get_main_file, "indexstore_unit_reader_get_main_file")
+            try binder.bind(\.unit_reader_get_module_name, "indexstore_unit_reader_get_module_name")
+            try binder.bind(\.unit_reader_get_target, "indexstore_unit_reader_get_target")
+            try binder.bind(\.unit_dependency_get_name, "indexstore_unit_dependency_get_name")
+            try binder.bind(\.unit_dependency_get_filepath, "indexstore_unit_dependency_get_filepath")
+            try binder.bind(\.unit_dependency_get_modulename, "indexstore_unit_dependency_get_modulename")
+            try binder.bind(\.unit_dependency_is_system, "indexstore_unit_dependency_is_system")
+            try binder.bind(\.record_reader_create, "indexstore_record_reader_create")
+            try binder.bind(\.record_reader_dispose, "indexstore_record_reader_dispose")
+            try binder.bind(\.record_reader_occurrences_apply_f, "indexstore_record_reader_occurrences_apply_f")
+            try binder.bind(\.record_reader_occurrences_of_symbols_apply_f, "indexstore_record_reader_occurrences_of_symbols_apply_f")
+            try binder.bind(\.record_reader_symbols_apply_f, "indexstore_record_reader_symbols_apply_f")
+            try binder.bind(\.occurrence_get_roles, "indexstore_occurrence_get_roles")
+            try binder.bind(\.occurrence_get_symbol, "indexstore_occurrence_get_symbol")
+            try binder.bind(\.symbol_get_kind, "indexstore_symbol_get_kind")
+            try binder.bind(\.symbol_get_subkind, "indexstore_symbol_get_subkind")
+            try binder.bind(\.symbol_get_usr, "indexstore_symbol_get_usr")
+            try binder.bind(\.symbol_get_name, "indexstore_symbol_get_name")
+            try binder.bind(\.symbol_get_roles, "indexstore_symbol_get_roles")
+            try binder.bind(\.occurrence_get_line_col, "indexstore_occurrence_get_line_col")
+            try binder.bind(\.error_get_description, "indexstore_error_get_description")
+            try binder.bind(\.occurrence_relations_apply_f, "indexstore_occurrence_relations_apply_f")
+            try binder.bind(\.symbol_relation_get_roles, "indexstore_symbol_relation_get_roles")
+            try binder.bind(\.symbol_relation_get_symbol, "indexstore_symbol_relation_get_symbol")
+            try binder.bind(\.symbol_get_language, "indexstore_symbol_get_language")
+        } catch {
+            api.deallocate()
+            throw error
+        }
+
+        return LibIndexStore(url: url, dylib: dylib, binder: binder)
+    }
+
+    /// Environment variable with the path of the libIndexStore to load,
+    /// which skips the toolchain lookup.
+    public static let libraryPathEnvironmentVariable = "LIBINDEXSTORE_PATH"
+
+    /// File remembering the libIndexStore found in the toolchain, so that
+    /// later processes don't have to spawn `which` or `xcode-select`.
+    public static var defaultLibraryPathCacheFile: URL? {
+        FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first?
+            .appendingPathComponent("SwiftIndexStore")
+            .appendingPathComponent("libIndexStore-path")
+    }
+
+    /// Opens the libIndexStore of the current toolchain, located by
+    /// `libraryURL(cacheFile:)`.
+    public static func open(cacheFile: URL? = defaultLibraryPathCacheFile) throws -> LibIndexStore {
+        try open(url: libraryURL(cacheFile: cacheFile))
+    }
+
+    /// The library opened by `open()`, loaded once per process.
+    public static var shared: LibIndexStore {
+        get throws { try sharedResult.get() }
+    }
+
+    private static let sharedResult = Result(catching: { try LibIndexStore.open() })
+
+    /// Locates libIndexStore from `LIBINDEXSTORE_PATH`, then from `cacheFile`,
+    /// and only then from the toolchain, whose answer is written back to
+    /// `cacheFile`.
+    ///
+    /// Cached paths are keyed by the environment variables the toolchain
+    /// lookup depends on, and ignored once the library no longer exists.
+    public static func libraryURL(cacheFile: URL? = defaultLibraryPathCacheFile) throws -> URL {
+        let environment = ProcessInfo.processInfo.environment
+        if let path = environment[libraryPathEnvironmentVariable], !path.isEmpty {
+            return URL(fileURLWithPath: path)
+        }
+
+        #if os(Linux)
+        let key = environment["PATH"] ?? ""
+        #else
+        let key = (environment["DEVELOPER_DIR"] ?? "") + "\n" + (environment["PATH"] ?? "")
+        #endif
+        if let cacheFile,
+           let cached = try? String(contentsOf: cacheFile, encoding: .utf8),
+           let separator = cached.lastIndex(of: "\n"),
+           cached[..<separator] == key {
+            let path = String(cached[cached.index(after: separator)...])
+            if FileManager.default.fileExists(atPath: path) {
+                return URL(fileURLWithPath: path)
             }
-            return unsafeBitCast(sym, to: T.self)
         }
 
-        api.store_create = try requireSym(dylib, "indexstore_store_create")
-        api.store_dispose = try requireSym(dylib, "indexstore_store_dispose")
-        api.store_units_apply_f = try requireSym(dylib, "indexstore_store_units_apply_f")
-        api.unit_reader_dependencies_apply_f = try requireSym(dylib, "indexstore_unit_reader_dependencies_apply_f")
-        api.unit_reader_is_system_unit = try requireSym(dylib, "indexstore_unit_reader_is_system_unit")
-        api.unit_dependency_get_kind = try requireSym(dylib, "indexstore_unit_dependency_get_kind")
-        api.unit_reader_create = try requireSym(dylib, "indexstore_unit_reader_create")
-        api.unit_reader_dispose = try requireSym(dylib, "indexstore_unit_reader_dispose")
-        api.unit_reader_get_main_file = try requireSym(dylib, "indexstore_unit_reader_get_main_file")
-        api.unit_reader_get_module_name = try requireSym(dylib, "indexstore_unit_reader_get_module_name")
-        api.unit_reader_get_target = try requireSym(dylib, "indexstore_unit_reader_get_target")
-        api.unit_dependency_get_name = try requireSym(dylib, "indexstore_unit_dependency_get_name")
-        api.unit_dependency_get_filepath = try requireSym(dylib, "indexstore_unit_dependency_get_filepath")
-        api.unit_dependency_get_modulename = try requireSym(dylib, "indexstore_unit_dependency_get_modulename")
-        api.unit_dependency_is_system = try requireSym(dylib, "indexstore_unit_dependency_is_system")
-        api.record_reader_create = try requireSym(dylib, "indexstore_record_reader_create")
-        api.record_reader_dispose = try requireSym(dylib, "indexstore_record_reader_dispose")
-        api.record_reader_occurrences_apply_f = try requireSym(dylib, "indexstore_record_reader_occurrences_apply_f")
-        api.record_reader_occurrences_of_symbols_apply_f = try requireSym(dylib, "indexstore_record_reader_occurrences_of_symbols_apply_f")
-        api.record_reader_symbols_apply_f = try requireSym(dylib, "indexstore_record_reader_symbols_apply_f")
-        api.occurrence_get_roles = try requireSym(dylib, "indexstore_occurrence_get_roles")
-        api.occurrence_get_symbol = try requireSym(dylib, "indexstore_occurrence_get_symbol")
-        api.symbol_get_kind = try requireSym(dylib, "indexstore_symbol_get_kind")
-        api.symbol_get_subkind = try requireSym(dylib, "indexstore_symbol_get_subkind")
-        api.symbol_get_usr = try requireSym(dylib, "indexstore_symbol_get_usr")
-        api.symbol_get_name = try requireSym(dylib, "indexstore_symbol_get_name")
-        api.occurrence_get_line_col = try requireSym(dylib, "indexstore_occurrence_get_line_col")
-        api.error_get_description = try requireSym(dylib, "indexstore_error_get_description")
-        api.occurrence_relations_apply_f = try requireSym(dylib, "indexstore_occurrence_relations_apply_f")
-        api.symbol_relation_get_roles = try requireSym(dylib, "indexstore_symbol_relation_get_roles")
-        api.symbol_relation_get_symbol = try requireSym(dylib, "indexstore_symbol_relation_get_symbol")
-        api.symbol_get_language = try requireSym(dylib, "indexstore_symbol_get_language")
-
-        return LibIndexStore(url: url, api: api)
-
-    }
-
-    public static func open() throws -> LibIndexStore {
         #if os(Linux)
         let url = try linuxSwiftDir().appendingPathComponent("lib/libIndexStore.so")
         #else
@@ -84,7 +214,15 @@ public class LibIndexStore {
             .appendingPathComponent("lib")
             .appendingPathComponent("libIndexStore.dylib")
         #endif
-        return try open(url: url)
+        if let cacheFile {
+            // A cache that can't be written only costs the next process a lookup.
+            try? FileManager.default.createDirectory(
+                at: cacheFile.deletingLastPathComponent(),
+                withIntermediateDirectories: true
+            )
+            try? Data((key + "\n" + url.path).utf8).write(to: cacheFile, options: .atomic)
+        }
+        return url
     }
 
     public static func linuxSwiftDir() throws -> URL {
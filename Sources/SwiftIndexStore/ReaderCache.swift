@@ -0,0 +1,219 @@
+import Foundation
+
+/// Limits of a reader cache. A `nil` limit is unbounded.
+public struct IndexStoreCacheConfiguration {
+    /// Maximum number of readers kept alive.
+    public var countLimit: Int?
+    /// Maximum estimated size in bytes of the readers kept alive.
+    public var costLimit: Int?
+    /// Number of independently locked partitions of the cache.
+    public var shardCount: Int
+
+    public init(countLimit: Int? = 1024, costLimit: Int? = nil, shardCount: Int = 16) {
+        self.countLimit = countLimit
+        self.costLimit = costLimit
+        self.shardCount = shardCount
+    }
+
+    public static let unbounded = IndexStoreCacheConfiguration(countLimit: nil, costLimit: nil)
+}
+
+public struct IndexStoreCacheStatistics: Equatable {
+    public var hits: Int = 0
+    public var misses: Int = 0
+    public var evictions: Int = 0
+    public var count: Int = 0
+    public var cost: Int = 0
+
+    public var hitRate: Double {
+        let lookups = hits + misses
+        return lookups == 0 ? 0 : Double(hits) / Double(lookups)
+    }
+}
+
+/// A sharded LRU cache of reader objects.
+///
+/// Values are reference types which release their underlying reader in
+/// `deinit`, so evicting an entry never invalidates a reader that a caller is
+/// still holding. Concurrent lookups of the same missing key create the value
+/// only once.
+final class ReaderCache<Key: Hashable, Value: AnyObject> {
+
+    private final class Entry {
+        let key: Key
+        /// Serializes creation of `value` between concurrent lookups.
+        let creationLock = UnfairLock()
+        var value: Value?
+        var cost = 0
+
+        weak var previous: Entry?
+        var next: Entry?
+
+        init(key: Key) {
+            self.key = key
+        }
+    }
+
+    private final class Shard {
+        let lock = UnfairLock()
+        var entries: [Key: Entry] = [:]
+        /// Most recently used entry.
+        var head: Entry?
+        /// Least recently used entry.
+        weak var tail: Entry?
+        var cost = 0
+        var statistics = IndexStoreCacheStatistics()
+
+        func moveToFront(_ entry: Entry) {
+            guard head !== entry else { return }
+            unlink(entry)
+            entry.next = head
+            head?.previous = entry
+            head = entry
+            if tail == nil {
+                tail = entry
+            }
+        }
+
+        func unlink(_ entry: Entry) {
+            let previous = entry.previous
+            let next = entry.next
+            if head === entry {
+                head = next
+            }
+            if tail === entry {
+                tail = previous
+            }
+            previous?.next = next
+            next?.previous = previous
+            entry.previous = nil
+            entry.next = nil
+        }
+
+        func remove(_ entry: Entry) {
+            unlink(entry)
+            entries[entry.key] = nil
+            cost -= entry.cost
+        }
+    }
+
+    private let shards: [Shard]
+    private let countLimit: Int?
+    private let costLimit: Int?
+    private let cost: (Key, Value) -> Int
+
+    init(configuration: IndexStoreCacheConfiguration, cost: @escaping (Key, Value) -> Int = { _, _ in 0 }) {
+        let shardCount = max(1, configuration.shardCount)
+        self.shards = (0..<shardCount).map { _ in Shard() }
+        self.countLimit = configuration.countLimit.map { max(1, ($0 + shardCount - 1) / shardCount) }
+        self.costLimit = configuration.costLimit.map { max(1, ($0 + shardCount - 1) / shardCount) }
+        self.cost = cost
+    }
+
+    var statistics: IndexStoreCacheStatistics {
+        shards.reduce(into: IndexStoreCacheStatistics()) { result, shard in
+            shard.lock.perform {
+                result.hits += shard.statistics.hits
+                result.misses += shard.statistics.misses
+                result.evictions += shard.statistics.evictions
+                result.count += shard.entries.count
+                result.cost += shard.cost
+            }
+        }
+    }
+
+    func value(for key: Key, create: () throws -> Value) throws -> Value {
+        let shard = self.shard(for: key)
+        let entry: Entry = shard.lock.perform {
+            if let existing = shard.entries[key] {
+                shard.statistics.hits += 1
+                shard.moveToFront(existing)
+                return existing
+            }
+            shard.statistics.misses += 1
+            let inserted = Entry(key: key)
+            shard.entries[key] = inserted
+            shard.moveToFront(inserted)
+            return inserted
+        }
+
+        var created = false
+        let value: Value
+        do {
+            value = try entry.creationLock.perform {
+                if let existing = entry.value {
+                    return existing
+                }
+                let newValue = try create()
+                entry.value = newValue
+                created = true
+                return newValue
+            }
+        } catch {
+            shard.lock.perform {
+                if shard.entries[key] === entry, entry.value == nil {
+                    shard.remove(entry)
+                }
+            }
+            throw error
+        }
+
+        if created {
+            let entryCost = costLimit == nil ? 0 : cost(key, value)
+            // The evicted entries are released once this statement completes,
+            // so readers are disposed outside of the shard lock.
+            _ = shard.lock.perform { () -> [Entry] in
+                guard shard.entries[key] === entry else { return [] }
+                entry.cost = entryCost
+                shard.cost += entryCost
+                return evict(from: shard, keeping: entry)
+            }
+        }
+        return value
+    }
+
+    /// Drops the entry of `key`, e.g. because the file it was read from was
+    /// replaced. Callers holding its value keep using it.
+    func removeValue(for key: Key) {
+        let shard = self.shard(for: key)
+        _ = shard.lock.perform { () -> Entry? in
+            guard let entry = shard.entries[key] else { return nil }
+            shard.remove(entry)
+            return entry
+        }
+    }
+
+    func removeAll() {
+        for shard in shards {
+            _ = shard.lock.perform { () -> [Entry] in
+                let entries = Array(shard.entries.values)
+                entries.forEach(shard.unlink)
+                shard.entries.removeAll()
+                shard.cost = 0
+                return entries
+            }
+        }
+    }
+
+    private func shard(for key: Key) -> Shard {
+        shards[Int(UInt(bitPattern: key.hashValue) % UInt(shards.count))]
+    }
+
+    private func evict(from shard: Shard, keeping protected: Entry) -> [Entry] {
+        var evicted: [Entry] = []
+        func isOverLimit() -> Bool {
+            if let countLimit, shard.entries.count > countLimit { return true }
+            if let costLimit, shard.cost > costLimit { return true }
+            return false
+        }
+        var candidate = shard.tail
+        while isOverLimit(), let entry = candidate {
+            candidate = entry.previous
+            guard entry !== protected else { continue }
+            shard.remove(entry)
+            shard.statistics.evictions += 1
+            evicted.append(entry)
+        }
+        return evicted
+    }
+}
@@ -3,30 +3,92 @@ import Foundation
 
 public final class IndexStore {
 
+    public struct Configuration {
+        public var unitReaderCache: IndexStoreCacheConfiguration
+        /// Record readers are not cached unless a configuration is given.
+        public var recordReaderCache: IndexStoreCacheConfiguration?
+
+        public init(
+            unitReaderCache: IndexStoreCacheConfiguration = .init(),
+            recordReaderCache: IndexStoreCacheConfiguration? = nil
+        ) {
+            self.unitReaderCache = unitReaderCache
+            self.recordReaderCache = recordReaderCache
+        }
+    }
+
     let store: indexstore_t
     let lib: LibIndexStore
+    public let path: URL
+
+    private let unitReaderCache: ReaderCache<IndexStoreUnit, UnitReader>
+    private let recordReaderCache: ReaderCache<String, RecordReader>?
+
+    var unitEventPoller: UnitEventPoller?
+    let unitEventLock = UnfairLock()
 
-    private var unitReacherCache = [IndexStoreUnit: indexstore_unit_reader_t]()
-    private let unitReacherCacheLock = UnfairLock()
+    var recordPathMap: [String: [IndexStoreUnit.Dependency.Record]]?
+    let recordPathMapLock = UnfairLock()
 
     deinit {
-        unitReacherCache.values.forEach { lib.unit_reader_dispose($0) }
+        unitEventPoller?.stop()
+        unitReaderCache.removeAll()
+        recordReaderCache?.removeAll()
         lib.store_dispose(store)
     }
 
-    private init(store: indexstore_t, lib: LibIndexStore) {
+    private init(store: indexstore_t, path: URL, lib: LibIndexStore, configuration: Configuration) {
         self.store = store
+        self.path = path
         self.lib = lib
+        let versionDirectory = path.appendingPathComponent("v\(lib.format_version())")
+        let unitsDirectory = versionDirectory.appendingPathComponent("units")
+        let recordsDirectory = versionDirectory.appendingPathComponent("records")
+        self.unitReaderCache = ReaderCache(configuration: configuration.unitReaderCache) { unit, _ in
+            guard let name = unit.name else { return 0 }
+            return fileSize(at: unitsDirectory.appendingPathComponent(name))
+        }
+        self.recordReaderCache = configuration.recordReaderCache.map {
+            ReaderCache(configuration: $0) { name, _ in
+                // Records are sharded into directories named after the last two
+                // characters of the record name.
+                fileSize(at: recordsDirectory
+                    .appendingPathComponent(String(name.suffix(2)))
+                    .appendingPathComponent(name))
+            }
+        }
     }
 
-    public static func open(store path: URL, lib: LibIndexStore) throws -> IndexStore {
+    public static func open(store path: URL, lib: LibIndexStore, configuration: Configuration = .init()) throws -> IndexStore {
         guard let store = try lib.throwsfy({ lib.store_create(path.path, &$0) }) else {
             throw IndexStoreError.unableOpen(path)
         }
-        return IndexStore(store: store, lib: lib)
+        return IndexStore(store: store, path: path, lib: lib, configuration: configuration)
+    }
+
+    public var unitReaderCacheStatistics: IndexStoreCacheStatistics {
+        unitReaderCache.statistics
+    }
+
+    /// `nil` when the store was opened without a record reader cache.
+    public var recordReaderCacheStatistics: IndexStoreCacheStatistics? {
+        recordReaderCache?.statistics
+    }
+
+    /// Drops the cached readers of `units`, which must be called once their
+    /// unit files are rewritten since a rebuild keeps the unit name.
+    public func invalidateUnitReaders(for units: [IndexStoreUnit]) {
+        for unit in units {
+            unitReaderCache.removeValue(for: unit)
+        }
     }
 
-    fileprivate class Context<T> {
+    /// Drops every cached unit reader.
+    public func invalidateUnitReaders() {
+        unitReaderCache.removeAll()
+    }
+
+    class Context<T> {
         let lib: LibIndexStore
         var content: T
         var error: Error?
@@ -58,84 +120,90 @@ public final class IndexStore {
         try collect(forEachFn: { try forEachOccurrences(for: record, symbols: symbols, relatedSymbols: relatedSymbols, $0) })
     }
 
+    /// Must be called from the scan callback `occ` was passed to.
     public func relations(for occ: IndexStoreOccurrence) -> [IndexStoreRelation] {
         collect(forEachFn: { forEachRelations(for: occ, $0) })
     }
 
     public func mainFilePath(for unit: IndexStoreUnit) throws -> String? {
-        let reader = try createUnitReader(for: unit)
-        return lib.unit_reader_get_main_file(reader).toSwiftString()
+        try withUnitReader(for: unit) { reader in
+            lib.unit_reader_get_main_file(reader).toSwiftString()
+        }
     }
 
     public func moduleName(for unit: IndexStoreUnit) throws -> String? {
-        let reader = try createUnitReader(for: unit)
-        return lib.unit_reader_get_module_name(reader).toSwiftString()
+        try withUnitReader(for: unit) { reader in
+            lib.unit_reader_get_module_name(reader).toSwiftString()
+        }
     }
 
     public func target(for unit: IndexStoreUnit) throws -> String? {
-        let reader = try createUnitReader(for: unit)
-        return lib.unit_reader_get_target(reader).toSwiftString()
+        try withUnitReader(for: unit) { reader in
+            lib.unit_reader_get_target(reader).toSwiftString()
+        }
     }
 
     // - MARK: ForEach Functions
 
     public func forEachUnits(includeSystem: Bool = true, _ next: (IndexStoreUnit) throws -> Bool) rethrows {
-        if includeSystem {
-            try _forEachUnits(next)
-        } else {
-            try _forEachUnits { unit in
-                let reader = try createUnitReader(for: unit)
-                let isSystem = lib.unit_reader_is_system_unit(reader)
+        try IndexStoreInstrumentation.measure(.units, next) { next in
+            if includeSystem {
+                try _forEachUnits(next)
+            } else {
+                try _forEachUnits { unit in
+                    if try !isSystemUnit(unit) {
+                        return try next(unit)
+                    }
 
-                if !isSystem {
-                    return try next(unit)
+                    return true
                 }
-
-                return true
             }
         }
     }
 
     public func forEachRecordDependencies(for unit: IndexStoreUnit, _ next: (IndexStoreUnit.Dependency) throws -> Bool) throws {
-        let reader = try createUnitReader(for: unit)
-        typealias Ctx = Context<((IndexStoreUnit.Dependency) throws -> Bool)>
-        try withoutActuallyEscaping(next) { next in
-            let handler = Ctx(next, lib: lib)
-            let ctx = Unmanaged.passUnretained(handler).toOpaque()
-            _ = lib.unit_reader_dependencies_apply_f(reader, ctx) { ctx, dependency -> Bool in
-                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
-                let dependency = IndexStore.createUnitDependency(from: dependency, lib: ctx.lib)
-                do { return try ctx.content(dependency) } catch {
-                    ctx.error = error
-                    return false
+        try IndexStoreInstrumentation.measure(.recordDependencies, next) { next in
+            typealias Ctx = Context<((IndexStoreUnit.Dependency) throws -> Bool)>
+            try withUnitReader(for: unit) { reader in
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx(next, lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.unit_reader_dependencies_apply_f(reader, ctx) { ctx, dependency -> Bool in
+                        let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                        let dependency = IndexStore.createUnitDependency(from: dependency, lib: ctx.lib)
+                        do { return try ctx.content(dependency) } catch {
+                            ctx.error = error
+                            return false
+                        }
+                    }
+                    if let error = handler.error {
+                        throw error
+                    }
                 }
             }
-            if let error = handler.error {
-                throw error
-            }
         }
     }
 
     public func forEachSymbols(for record: IndexStoreUnit.Dependency.Record, _ next: (IndexStoreSymbol) throws -> Bool) throws {
-        guard let reader = try lib.throwsfy({ lib.record_reader_create(store, record.name, &$0) }) else {
-            throw IndexStoreError.unableCreateRecordReader(record.name)
-        }
-        defer { lib.record_reader_dispose(reader) }
-        typealias Ctx = Context<(IndexStoreSymbol) throws -> Bool>
-        try withoutActuallyEscaping(next) { next in
-            let handler = Ctx(next, lib: lib)
-            let ctx = Unmanaged.passUnretained(handler).toOpaque()
-            _ = lib.record_reader_symbols_apply_f(reader, true, ctx) { ctx, symbol -> Bool in
-                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
-                let sym = IndexStore.createSymbol(from: symbol, lib: ctx.lib)
-                do { return try ctx.content(sym) } catch {
-                    ctx.error = error
-                    return false
+        try IndexStoreInstrumentation.measure(.symbols, next) { next in
+            typealias Ctx = Context<(next: (IndexStoreSymbol) throws -> Bool, owner: RecordReader)>
+            try withRecordReader(for: record) { reader in
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, reader), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.record_reader_symbols_apply_f(reader.reader, recordReaderCache == nil, ctx) { ctx, symbol -> Bool in
+                        let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                        let sym = IndexStore.createSymbol(from: symbol, owner: ctx.content.owner, lib: ctx.lib)
+                        do { return try ctx.content.next(sym) } catch {
+                            ctx.error = error
+                            return false
+                        }
+                    }
+                    if let error = handler.error {
+                        throw error
+                    }
                 }
             }
-            if let error = handler.error {
-                throw error
-            }
         }
     }
 
@@ -144,37 +212,77 @@ public final class IndexStore {
                                    relatedSymbols: [IndexStoreSymbol],
                                    language: IndexStoreSymbol.Language? = nil,
                                    _ next: (IndexStoreOccurrence) throws -> Bool) throws {
-
-        guard let reader = try lib.throwsfy({ lib.record_reader_create(store, record.name, &$0) }) else {
-            throw IndexStoreError.unableCreateRecordReader(record.name)
+        try IndexStoreInstrumentation.measure(.occurrences, next) { next in
+            typealias Ctx = Context<(
+                next: (IndexStoreOccurrence) throws -> Bool,
+                recordPath: String?,
+                isSystem: Bool,
+                language: UInt32?,
+                owner: RecordReader
+            )>
+
+            try withRecordReader(for: record) { reader in
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, record.filePath, record.isSystem, language?.rawValue, reader), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    var symbols = symbols.map { $0.anchor }
+                    var relatedSymbols = relatedSymbols.map { $0.anchor }
+                    _ = try symbols.withContiguousMutableStorageIfAvailable { syms in
+                        _ = try relatedSymbols.withContiguousMutableStorageIfAvailable { relatedSyms in
+                            _ = lib.record_reader_occurrences_of_symbols_apply_f(
+                                reader.reader, syms.baseAddress!, syms.count,
+                                relatedSyms.baseAddress!, relatedSyms.count,
+                                ctx
+                            ) { ctx, occurrence -> Bool in
+                                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                                guard let occ = IndexStore.createOccurrence(
+                                    from: occurrence,
+                                    recordPath: ctx.content.recordPath,
+                                    isSystem: ctx.content.isSystem,
+                                    language: ctx.content.language,
+                                    owner: ctx.content.owner,
+                                    lib: ctx.lib
+                                ) else { return true }
+                                do { return try ctx.content.next(occ) } catch {
+                                    ctx.error = error
+                                    return false
+                                }
+                            }
+                            if let error = handler.error {
+                                throw error
+                            }
+                        }
+                    }
+                }
+            }
         }
-        defer { lib.record_reader_dispose(reader) }
-
-        typealias Ctx = Context<(
-            next: (IndexStoreOccurrence) throws -> Bool,
-            recordPath: String?,
-            isSystem: Bool,
-            language: UInt32?
-        )>
+    }
 
-        try withoutActuallyEscaping(next) { next in
-            let handler = Ctx((next, record.filePath, record.isSystem, language?.rawValue), lib: lib)
-            let ctx = Unmanaged.passUnretained(handler).toOpaque()
-            var symbols = symbols.map { $0.anchor }
-            var relatedSymbols = relatedSymbols.map { $0.anchor }
-            _ = try symbols.withContiguousMutableStorageIfAvailable { syms in
-                _ = try relatedSymbols.withContiguousMutableStorageIfAvailable { relatedSyms in
-                    _ = lib.record_reader_occurrences_of_symbols_apply_f(
-                        reader, syms.baseAddress!, syms.count,
-                        relatedSyms.baseAddress!, relatedSyms.count,
-                        ctx
-                    ) { ctx, occurrence -> Bool in
+    public func forEachOccurrences(
+        for record: IndexStoreUnit.Dependency.Record,
+        language: IndexStoreSymbol.Language? = nil,
+        _ next: (IndexStoreOccurrence) throws -> Bool) throws {
+        try IndexStoreInstrumentation.measure(.occurrences, next) { next in
+            typealias Ctx = Context<(
+                next: (IndexStoreOccurrence) throws -> Bool,
+                recordPath: String?,
+                isSystem: Bool,
+                language: UInt32?,
+                owner: RecordReader
+            )>
+
+            try withRecordReader(for: record) { reader in
+                try withoutActuallyEscaping(next) { next in
+                    let handler = Ctx((next, record.filePath, record.isSystem, language?.rawValue, reader), lib: lib)
+                    let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                    _ = lib.record_reader_occurrences_apply_f(reader.reader, ctx) { ctx, occurrence -> Bool in
                         let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
                         guard let occ = IndexStore.createOccurrence(
                             from: occurrence,
                             recordPath: ctx.content.recordPath,
                             isSystem: ctx.content.isSystem,
                             language: ctx.content.language,
+                            owner: ctx.content.owner,
                             lib: ctx.lib
                         ) else { return true }
                         do { return try ctx.content.next(occ) } catch {
@@ -190,88 +298,87 @@ public final class IndexStore {
         }
     }
 
-    public func forEachOccurrences(
-        for record: IndexStoreUnit.Dependency.Record,
-        language: IndexStoreSymbol.Language? = nil,
-        _ next: (IndexStoreOccurrence) throws -> Bool) throws {
-        guard let reader = try lib.throwsfy({ lib.record_reader_create(store, record.name, &$0) }) else {
-            throw IndexStoreError.unableCreateRecordReader(record.name)
-        }
-        defer { lib.record_reader_dispose(reader) }
-        typealias Ctx = Context<(
-            next: (IndexStoreOccurrence) throws -> Bool,
-            recordPath: String?,
-            isSystem: Bool,
-            language: UInt32?
-        )>
-
-        try withoutActuallyEscaping(next) { next in
-            let handler = Ctx((next, record.filePath, record.isSystem, language?.rawValue), lib: lib)
-            let ctx = Unmanaged.passUnretained(handler).toOpaque()
-            _ = lib.record_reader_occurrences_apply_f(reader, ctx) { ctx, occurrence -> Bool in
-                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
-                guard let occ = IndexStore.createOccurrence(
-                    from: occurrence,
-                    recordPath: ctx.content.recordPath,
-                    isSystem: ctx.content.isSystem,
-                    language: ctx.content.language,
-                    lib: ctx.lib
-                ) else { return true }
-                do { return try ctx.content.next(occ) } catch {
-                    ctx.error = error
-                    return false
-                }
-            }
-            if let error = handler.error {
-                throw error
-            }
-        }
-    }
-
+    /// Must be called from the scan callback `occ` was passed to.
     public func forEachRelations(for occ: IndexStoreOccurrence, _ next: (IndexStoreRelation) throws -> Bool) rethrows {
-        typealias Ctx = Context<((IndexStoreRelation) throws -> Bool)>
-        try withoutActuallyEscaping(next) { next in
-            let handler = Ctx(next, lib: lib)
-            let ctx = Unmanaged.passUnretained(handler).toOpaque()
-            _ = lib.occurrence_relations_apply_f(occ.anchor, ctx) { ctx, relation -> Bool in
-                let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
-                let roles = IndexStoreOccurrence.Role(rawValue: ctx.lib.symbol_relation_get_roles(relation))
-                let symbol = IndexStore.createSymbol(
-                    from: ctx.lib.symbol_relation_get_symbol(relation),
-                    lib: ctx.lib
-                )
-                let rel = IndexStoreRelation(roles: roles, symbol: symbol)
-                do { return try ctx.content(rel) } catch {
-                    ctx.error = error
-                    return false
+        try IndexStoreInstrumentation.measure(.relations, next) { next in
+            typealias Ctx = Context<(next: (IndexStoreRelation) throws -> Bool, owner: AnyObject?)>
+            try withoutActuallyEscaping(next) { next in
+                let handler = Ctx((next, occ.symbol.owner), lib: lib)
+                let ctx = Unmanaged.passUnretained(handler).toOpaque()
+                _ = lib.occurrence_relations_apply_f(occ.anchor, ctx) { ctx, relation -> Bool in
+                    let ctx = Unmanaged<Ctx>.fromOpaque(ctx!).takeUnretainedValue()
+                    let roles = IndexStoreOccurrence.Role(rawValue: ctx.lib.symbol_relation_get_roles(relation))
+                    let symbol = IndexStore.createSymbol(
+                        from: ctx.lib.symbol_relation_get_symbol(relation),
+                        owner: ctx.content.owner,
+                        lib: ctx.lib
+                    )
+                    let rel = IndexStoreRelation(roles: roles, symbol: symbol)
+                    do { return try ctx.content.next(rel) } catch {
+                        ctx.error = error
+                        return false
+                    }
+                }
+                if let error = handler.error {
+                    throw error
                 }
-            }
-            if let error = handler.error {
-                throw error
             }
         }
     }
 
     // - MARK: Private
 
-    private func createUnitReader(for unit: IndexStoreUnit) throws -> indexstore_unit_reader_t {
-        let reader = unitReacherCacheLock.perform {
-            unitReacherCache[unit]
+    func isSystemUnit(_ unit: IndexStoreUnit) throws -> Bool {
+        try withUnitReader(for: unit) { reader in
+            lib.unit_reader_is_system_unit(reader)
         }
+    }
 
-        if let reader {
-            return reader
+    /// Calls `body` with a cached unit reader, which stays valid until `body`
+    /// returns even if it is evicted concurrently.
+    func withUnitReader<T>(for unit: IndexStoreUnit, _ body: (indexstore_unit_reader_t) throws -> T) throws -> T {
+        let reader = try unitReaderCache.value(for: unit) {
+            guard let reader = try lib.throwsfy({ lib.unit_reader_create(store, unit.name, &$0) }) else {
+                throw IndexStoreError.unableCreateUnitReader(unit.name)
+            }
+            return UnitReader(reader, lib: lib)
         }
+        return try withExtendedLifetime(reader) {
+            try body(reader.reader)
+        }
+    }
 
-        guard let reader = try lib.throwsfy({ lib.unit_reader_create(store, unit.name, &$0) }) else {
-            throw IndexStoreError.unableCreateUnitReader(unit.name)
+    /// Calls `body` with a record reader for `record`, taken from the record
+    /// reader cache when it is enabled.
+    ///
+    /// Record readers are not safe to use from several threads at once, so a
+    /// cached reader that is already in use is bypassed with a fresh one.
+    func withRecordReader<T>(for record: IndexStoreUnit.Dependency.Record, _ body: (RecordReader) throws -> T) throws -> T {
+        func createRecordReader() throws -> RecordReader {
+            guard let reader = try lib.throwsfy({ lib.record_reader_create(store, record.name, &$0) }) else {
+                throw IndexStoreError.unableCreateRecordReader(record.name)
+            }
+            return RecordReader(reader, lib: lib)
         }
 
-        unitReacherCacheLock.perform {
-            unitReacherCache[unit] = reader
+        guard let recordReaderCache, let name = record.name else {
+            let reader = try createRecordReader()
+            return try body(reader)
         }
 
-        return reader
+        let cached = try recordReaderCache.value(for: name, create: createRecordReader)
+        let reader: RecordReader
+        if cached.acquire() {
+            reader = cached
+        } else {
+            reader = try createRecordReader()
+        }
+        defer {
+            if reader === cached {
+                cached.release()
+            }
+        }
+        return try body(reader)
     }
 
     private func _forEachUnits(_ next: (IndexStoreUnit) throws -> Bool) rethrows {
@@ -313,28 +420,62 @@ public final class IndexStore {
         }
     }
 
-    private static func createSymbol(
+    /// `owner` keeps the record reader that `symbol` belongs to alive, so that
+    /// its USR and name can be decoded lazily.
+    static func createSymbol(
         from symbol: indexstore_symbol_t?,
         language: UInt32? = nil,
+        owner: AnyObject?,
+        lib: LibIndexStore) -> IndexStoreSymbol {
+        IndexStoreInstrumentation.measureConstruction {
+            makeSymbol(from: symbol, language: language, owner: owner, lib: lib)
+        }
+    }
+
+    private static func makeSymbol(
+        from symbol: indexstore_symbol_t?,
+        language: UInt32?,
+        owner: AnyObject?,
         lib: LibIndexStore) -> IndexStoreSymbol {
         let symbolKind = IndexStoreSymbol.Kind(rawValue: lib.symbol_get_kind(symbol).rawValue)!
         let symbolSubKind = IndexStoreSymbol.SubKind(rawValue: lib.symbol_get_subkind(symbol).rawValue)!
-        let symbolUsr = lib.symbol_get_usr(symbol).toSwiftString()
-        let symbolName = lib.symbol_get_name(symbol).toSwiftString()
         let symbolLanguage = IndexStoreSymbol.Language(rawValue: language ?? lib.symbol_get_language(symbol).rawValue)!
         return IndexStoreSymbol(
-            usr: symbolUsr, name: symbolName,
+            usr: lib.symbol_get_usr(symbol),
+            name: lib.symbol_get_name(symbol),
             kind: symbolKind, subKind: symbolSubKind,
             language: symbolLanguage,
-            anchor: symbol
+            anchor: symbol,
+            owner: owner
         )
     }
 
-    private static func createOccurrence(
+    static func createOccurrence(
         from occurrence: indexstore_occurrence_t?,
         recordPath: String?,
         isSystem: Bool,
         language: UInt32?,
+        owner: AnyObject?,
+        lib: LibIndexStore
+    ) -> IndexStoreOccurrence? {
+        IndexStoreInstrumentation.measureConstruction {
+            makeOccurrence(
+                from: occurrence,
+                recordPath: recordPath,
+                isSystem: isSystem,
+                language: language,
+                owner: owner,
+                lib: lib
+            )
+        }
+    }
+
+    private static func makeOccurrence(
+        from occurrence: indexstore_occurrence_t?,
+        recordPath: String?,
+        isSystem: Bool,
+        language: UInt32?,
+        owner: AnyObject?,
         lib: LibIndexStore
     ) -> IndexStoreOccurrence? {
         let symbol = lib.occurrence_get_symbol(occurrence)
@@ -345,9 +486,10 @@ public final class IndexStore {
         }
 
         let symbolRoles = IndexStoreOccurrence.Role(rawValue: lib.occurrence_get_roles(occurrence))
-        let sym = IndexStore.createSymbol(
+        let sym = IndexStore.makeSymbol(
             from: symbol,
             language: language,
+            owner: owner,
             lib: lib
         )
         var line: UInt32 = 0
@@ -370,9 +512,64 @@ public final class IndexStore {
     }
 }
 
+final class UnitReader {
+    let reader: indexstore_unit_reader_t
+    private let lib: LibIndexStore
+
+    init(_ reader: indexstore_unit_reader_t, lib: LibIndexStore) {
+        self.reader = reader
+        self.lib = lib
+        IndexStoreInstrumentation.active?.recordReader(unit: true, created: true)
+    }
+
+    deinit {
+        lib.unit_reader_dispose(reader)
+        IndexStoreInstrumentation.active?.recordReader(unit: true, created: false)
+    }
+}
+
+final class RecordReader {
+    let reader: indexstore_record_reader_t
+    private let lib: LibIndexStore
+    private let lock = UnfairLock()
+    private var isInUse = false
+
+    init(_ reader: indexstore_record_reader_t, lib: LibIndexStore) {
+        self.reader = reader
+        self.lib = lib
+        IndexStoreInstrumentation.active?.recordReader(unit: false, created: true)
+    }
+
+    deinit {
+        lib.record_reader_dispose(reader)
+        IndexStoreInstrumentation.active?.recordReader(unit: false, created: false)
+    }
+
+    /// Marks the reader as used by the calling thread. Returns `false` if it
+    /// is already in use.
+    func acquire() -> Bool {
+        lock.perform {
+            guard !isInUse else { return false }
+            isInUse = true
+            return true
+        }
+    }
+
+    func release() {
+        lock.perform {
+            isInUse = false
+        }
+    }
+}
+
+private func fileSize(at url: URL) -> Int {
+    let attributes = try? FileManager.default.attributesOfItem(atPath: url.path)
+    return (attributes?[.size] as? NSNumber)?.intValue ?? 0
+}
+
 extension LibIndexStore {
 
-    fileprivate func throwsfy<T>(_ fn: (inout indexstore_error_t?) -> T) throws -> T {
+    func throwsfy<T>(_ fn: (inout indexstore_error_t?) -> T) throws -> T {
         var error: indexstore_error_t?
         let ret = fn(&error)
 
@@ -391,12 +588,3 @@ extension Bool {
         self ? 1 : 0
     }
 }
-
-extension indexstore_string_ref_t {
-    fileprivate func toSwiftString() -> String? {
-        guard data != nil else { return nil }
-        return String(
-            data: Data(bytesNoCopy: UnsafeMutableRawPointer(mutating: data), count: length, deallocator: .none),
-            encoding: .utf8)
-    }
-}
@@ -32,14 +32,12 @@ public final class UnfairLock {
     public func perform<T>(_ operation: () throws -> T) rethrows -> T {
 #if canImport(os)
         osAllocatedUnfairLock.lock()
-        let value = try operation()
-        osAllocatedUnfairLock.unlock()
-        return value
+        defer { osAllocatedUnfairLock.unlock() }
+        return try operation()
 #else
         nsLock.lock()
-        let value = try operation()
-        nsLock.unlock()
-        return value
+        defer { nsLock.unlock() }
+        return try operation()
 #endif
     }
 }
@@ -0,0 +1,98 @@
+#include "allocation_counter.h"
+
+#include <stddef.h>
+
+static bool counting;
+static uint64_t allocations;
+
+static inline void count_allocation(void) {
+  // Skipped with a plain load when not counting, so that concurrent
+  // benchmarks don't contend on the counter.
+  if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  }
+}
+
+#if defined(__APPLE__)
+
+// Exported by libmalloc and called on every allocation and deallocation when
+// set, as malloc stack logging does.
+typedef void(malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                              uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern malloc_logger_t *malloc_logger;
+
+#define MALLOC_LOG_TYPE_ALLOCATE 2
+
+static void log_allocation(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                           uintptr_t result, uint32_t num_hot_frames_to_skip) {
+  if (type & MALLOC_LOG_TYPE_ALLOCATE) {
+    count_allocation();
+  }
+}
+
+bool swiftindexstore_allocation_counter_is_available(void) {
+  return true;
+}
+
+void swiftindexstore_allocation_counter_start(void) {
+  __atomic_store_n(&allocations, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&counting, true, __ATOMIC_RELAXED);
+  malloc_logger = log_allocation;
+}
+
+uint64_t swiftindexstore_allocation_counter_stop(void) {
+  malloc_logger = NULL;
+  __atomic_store_n(&counting, false, __ATOMIC_RELAXED);
+  return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+#elif defined(__GLIBC__)
+
+// glibc lets a program replace malloc; these forward to its own allocator,
+// so memory allocated on either side can be freed on the other.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) {
+  count_allocation();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  count_allocation();
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+  count_allocation();
+  return __libc_realloc(pointer, size);
+}
+
+bool swiftindexstore_allocation_counter_is_available(void) {
+  return true;
+}
+
+void swiftindexstore_allocation_counter_start(void) {
+  __atomic_store_n(&allocations, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&counting, true, __ATOMIC_RELAXED);
+}
+
+uint64_t swiftindexstore_allocation_counter_stop(void) {
+  __atomic_store_n(&counting, false, __ATOMIC_RELAXED);
+  return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool swiftindexstore_allocation_counter_is_available(void) {
+  return false;
+}
+
+void swiftindexstore_allocation_counter_start(void) {}
+
+uint64_t swiftindexstore_allocation_counter_stop(void) {
+  return 0;
+}
+
+#endif
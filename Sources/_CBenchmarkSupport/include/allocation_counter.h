@@ -0,0 +1,20 @@
+#ifndef SWIFTINDEXSTORE_ALLOCATION_COUNTER_H
+#define SWIFTINDEXSTORE_ALLOCATION_COUNTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Counts heap allocations made by any thread of the process between start and
+ * stop. Only calls to malloc, calloc and realloc are seen, through a malloc
+ * replacement with glibc and the malloc logger on Darwin, so the count is a
+ * lower bound. */
+
+/* Whether allocations can be counted on this platform. */
+bool swiftindexstore_allocation_counter_is_available(void);
+
+void swiftindexstore_allocation_counter_start(void);
+
+/* Stops counting and returns the allocations counted since start. */
+uint64_t swiftindexstore_allocation_counter_stop(void);
+
+#endif
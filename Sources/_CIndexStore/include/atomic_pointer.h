@@ -0,0 +1,15 @@
+#ifndef SWIFTINDEXSTORE_ATOMIC_POINTER_H
+#define SWIFTINDEXSTORE_ATOMIC_POINTER_H
+
+/* Atomic access to a pointer-sized slot, for state read on hot paths without
+ * taking a lock. */
+
+static inline void *_Nullable swiftindexstore_atomic_load_pointer(void *_Nullable *_Nonnull slot) {
+  return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+static inline void swiftindexstore_atomic_store_pointer(void *_Nullable *_Nonnull slot, void *_Nullable value) {
+  __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -1,4 +1,5 @@
 import Foundation
+import XCTest
 @testable import SwiftIndexStore
 
 class IndexSpace {
@@ -43,6 +44,11 @@ class IndexSpace {
         }
     }
 
+    func index(sourceNamed name: String) throws {
+        let location = try XCTUnwrap(sources.first { $0.url.lastPathComponent == name })
+        try index(at: location)
+    }
+
     private func index(at location: SourceLocation, file: String = #file) throws {
         let fileURL = URL(fileURLWithPath: file)
         let testsIndex = fileURL.pathComponents.firstIndex(of: "Tests") ?? 0
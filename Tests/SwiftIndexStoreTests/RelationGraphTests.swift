@@ -0,0 +1,53 @@
+import XCTest
+@testable import SwiftIndexStore
+
+final class RelationGraphTests: XCTestCase {
+
+    func testRelationGraph() throws {
+        let space = try IndexSpace.create(with: .init())
+        try space.addSource(name: "Shapes.swift", module: "RelationModule", sourceCode: """
+        class Shape {
+            func area() -> Int { 0 }
+        }
+        class Square: Shape {
+            override func area() -> Int { side() * side() }
+            func side() -> Int { 2 }
+        }
+        class Tile: Square {}
+        extension Shape {
+            func describe() -> Int { area() }
+        }
+        """)
+        try space.index()
+        let lib = try LibIndexStore.open()
+        let indexStore = try IndexStore.open(store: space.indexStorePath, lib: lib)
+        let graph = try indexStore.relationGraph(includeSystem: false)
+
+        let symbols = try indexStore.units(includeSystem: false)
+            .flatMap { try indexStore.recordDependencies(for: $0).compactMap(\.record) }
+            .flatMap { try indexStore.symbols(for: $0) }
+        func usr(_ name: String, _ kind: IndexStoreSymbol.Kind) throws -> String {
+            try XCTUnwrap(symbols.first { $0.name == name && $0.kind == kind }?.usr)
+        }
+        let shape = try usr("Shape", .class)
+        let square = try usr("Square", .class)
+        let tile = try usr("Tile", .class)
+        let squareArea = try XCTUnwrap(symbols.first {
+            $0.name == "area()" && $0.usr?.contains("Square") ?? false
+        }?.usr)
+        let shapeArea = try XCTUnwrap(symbols.first {
+            $0.name == "area()" && $0.usr?.contains("Shape") ?? false
+        }?.usr)
+        let side = try usr("side()", .instanceMethod)
+
+        XCTAssertEqual(graph.callees(of: squareArea), [side])
+        XCTAssertEqual(graph.callers(of: side), [squareArea])
+        XCTAssertEqual(graph.superclasses(of: tile), [square])
+        XCTAssertEqual(Set(graph.superclasses(of: tile, transitive: true)), [square, shape])
+        XCTAssertEqual(Set(graph.subclasses(of: shape, transitive: true)), [square, tile])
+        XCTAssertEqual(graph.overrides(of: shapeArea), [squareArea])
+        XCTAssertEqual(graph.overridden(by: squareArea), [shapeArea])
+        XCTAssertEqual(graph.extensions(of: shape).count, 1)
+        XCTAssertTrue(graph.callers(of: "s:no.such.usr").isEmpty)
+    }
+}
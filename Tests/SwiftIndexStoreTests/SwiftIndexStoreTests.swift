@@ -215,4 +215,799 @@ final class SwiftIndexStoreTests: XCTestCase {
             return true
         }
     }
+
+    func testConcurrentMapRecordsMatchesSerialTraversal() throws {
+        func describe(_ unit: IndexStoreUnit, _ record: IndexStoreUnit.Dependency.Record) throws -> String {
+            guard !record.isSystem else { return "\(unit.name ?? "") \(record.name ?? "")" }
+            let occs = try indexStore.occurrences(for: record).map {
+                "\($0.symbol.usr ?? ""):\($0.location.line):\($0.location.column):\($0.roles.rawValue)"
+            }
+            return "\(unit.name ?? "") \(record.name ?? "") [\(occs.joined(separator: ","))]"
+        }
+
+        var serial: [String] = []
+        try indexStore.forEachUnits { unit -> Bool in
+            try indexStore.forEachRecordDependencies(for: unit) { dependency -> Bool in
+                guard case let .record(record) = dependency else { return true }
+                serial.append(try describe(unit, record))
+                return true
+            }
+            return true
+        }
+        XCTAssertFalse(serial.isEmpty)
+
+        for workerCount in [1, 2, 4, 8] {
+            let concurrent = try indexStore.concurrentMapRecords(workerCount: workerCount) { unit, record in
+                try describe(unit, record)
+            }
+            XCTAssertEqual(concurrent, serial, "workerCount = \(workerCount)")
+        }
+    }
+
+    func testRecordOwnership() throws {
+        let ownership = try indexStore.recordOwnership()
+        let names = ownership.records.compactMap(\.record.name)
+        XCTAssertEqual(names.count, Set(names).count)
+        XCTAssertGreaterThanOrEqual(ownership.dependencyCount, ownership.distinctRecordCount)
+        XCTAssertGreaterThanOrEqual(ownership.dedupRatio, 1)
+
+        let entry = try XCTUnwrap(ownership.records.first {
+            $0.record.filePath?.contains("ViewController.swift") ?? false
+        })
+        XCTAssertTrue(entry.units.contains { $0.name?.contains("ViewController") ?? false })
+
+        var visited: [String] = []
+        try indexStore.forEachDistinctRecords { entry in
+            visited.append(entry.record.name ?? "")
+            return true
+        }
+        XCTAssertEqual(visited, names)
+    }
+
+    func testUnitReaderCacheEviction() throws {
+        let configuration = IndexStore.Configuration(
+            unitReaderCache: .init(countLimit: 1, shardCount: 1)
+        )
+        let store = try IndexStore.open(store: Self.space.indexStorePath, lib: indexStore.lib, configuration: configuration)
+        let units = store.units()
+        XCTAssertGreaterThan(units.count, 1)
+
+        for unit in units {
+            _ = try store.moduleName(for: unit)
+            _ = try store.target(for: unit)
+        }
+        let stats = store.unitReaderCacheStatistics
+        XCTAssertEqual(stats.count, 1)
+        XCTAssertEqual(stats.misses, units.count)
+        XCTAssertEqual(stats.hits, units.count)
+        XCTAssertEqual(stats.evictions, units.count - 1)
+
+        let names = try store.concurrentMapUnits(workerCount: 4) { unit in
+            try store.moduleName(for: unit)
+        }
+        XCTAssertEqual(names.count, units.count)
+    }
+
+    func testRecordReaderCache() throws {
+        let configuration = IndexStore.Configuration(
+            recordReaderCache: .init(countLimit: 8, shardCount: 1)
+        )
+        let store = try IndexStore.open(store: Self.space.indexStorePath, lib: indexStore.lib, configuration: configuration)
+        XCTAssertNil(indexStore.recordReaderCacheStatistics)
+
+        let unit = try XCTUnwrap(store.units().first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(store.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let symbols = try store.symbols(for: record)
+        let occurrences = try store.occurrences(for: record)
+        XCTAssertFalse(symbols.isEmpty)
+        XCTAssertEqual(occurrences.count, try indexStore.occurrences(for: record).count)
+
+        var stats = try XCTUnwrap(store.recordReaderCacheStatistics)
+        XCTAssertEqual(stats.misses, 1)
+        XCTAssertEqual(stats.hits, 1)
+
+        // A nested query on a reader that is in use falls back to a fresh reader.
+        try store.forEachSymbols(for: record) { symbol in
+            guard symbol.name == "viewModel" else { return true }
+            let occs = try store.occurrences(for: record, symbols: [symbol], relatedSymbols: [])
+            XCTAssertFalse(occs.isEmpty)
+            return true
+        }
+        stats = try XCTUnwrap(store.recordReaderCacheStatistics)
+        XCTAssertEqual(stats.count, 1)
+    }
+
+    func testStringRefs() throws {
+        let unit = indexStore.units().first(where: { $0.name?.contains("ViewController") ?? false })!
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let occs = try indexStore.occurrences(for: record)
+        var refsByUSR: [IndexStoreStringRef: String] = [:]
+        for occ in occs {
+            let usrRef = try XCTUnwrap(occ.symbol.usrRef)
+            let usr = try XCTUnwrap(occ.symbol.usr)
+            XCTAssertTrue(usrRef == usr)
+            XCTAssertEqual(usrRef.string, usr)
+            XCTAssertEqual(usrRef.count, usr.utf8.count)
+            XCTAssertTrue(usrRef.hasPrefix("s:"))
+            XCTAssertFalse(usrRef.hasPrefix(usr + "_"))
+            if let existing = refsByUSR[usrRef] {
+                XCTAssertEqual(existing, usr)
+            }
+            refsByUSR[usrRef] = usr
+        }
+        XCTAssertEqual(Set(refsByUSR.values), Set(occs.compactMap(\.symbol.usr)))
+
+        var symbol = try XCTUnwrap(occs.first).symbol
+        symbol.name = "renamed"
+        XCTAssertEqual(symbol.name, "renamed")
+        XCTAssertNil(symbol.nameRef)
+
+        // Invalid UTF-8 decodes to nil instead of replacement characters.
+        XCTAssertEqual([UInt8]("s:é".utf8).withUnsafeBytes(decodeUTF8), "s:é")
+        XCTAssertNil([UInt8]([0x73, 0x3a, 0xff]).withUnsafeBytes(decodeUTF8))
+        XCTAssertNil([UInt8]([0xc3]).withUnsafeBytes(decodeUTF8))
+    }
+
+    func testOccurrenceRefs() throws {
+        let unit = indexStore.units().first(where: { $0.name?.contains("ViewController") ?? false })!
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let occs = try indexStore.occurrences(for: record)
+        // Relations can only be read while their occurrence is being visited.
+        var expectedRelations: [[String]] = []
+        try indexStore.forEachOccurrences(for: record) { occ in
+            expectedRelations.append(indexStore.relations(for: occ).map { "\($0.roles.rawValue):\($0.symbol.usr ?? "")" })
+            return true
+        }
+        XCTAssertEqual(expectedRelations.count, occs.count)
+
+        var index = 0
+        try indexStore.forEachOccurrenceRefs(for: record) { ref in
+            let occ = occs[index]
+            let relations = expectedRelations[index]
+            index += 1
+            XCTAssertEqual(ref.roles, occ.roles)
+            XCTAssertTrue(ref.symbol.usr == occ.symbol.usr ?? "")
+            XCTAssertEqual(ref.symbol.kind, occ.symbol.kind)
+            XCTAssertEqual(ref.line, occ.location.line)
+            XCTAssertEqual(ref.column, occ.location.column)
+
+            var refRelations: [String] = []
+            ref.forEachRelation { roles, symbol in
+                refRelations.append("\(roles.rawValue):\(symbol.usr.string ?? "")")
+                return true
+            }
+            XCTAssertEqual(refRelations, relations)
+
+            let materialized = ref.materialize()
+            XCTAssertEqual(materialized.symbol.usr, occ.symbol.usr)
+            XCTAssertEqual(materialized.location, occ.location)
+            return true
+        }
+        XCTAssertEqual(index, occs.count)
+
+        var symbolNames: [String] = []
+        try indexStore.forEachSymbolRefs(for: record) { ref in
+            symbolNames.append(ref.name.string ?? "")
+            return true
+        }
+        XCTAssertEqual(symbolNames, try indexStore.symbols(for: record).map { $0.name ?? "" })
+    }
+
+    func testOccurrenceFilter() throws {
+        let unit = indexStore.units().first(where: { $0.name?.contains("ViewController") ?? false })!
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let all = try indexStore.occurrences(for: record)
+
+        func occurrences(matching filter: IndexStoreOccurrenceFilter) throws -> [String] {
+            var result: [String] = []
+            try indexStore.forEachOccurrences(for: record, matching: filter) { occ in
+                result.append("\(occ.symbol.usr ?? ""):\(occ.location.line):\(occ.location.column)")
+                return true
+            }
+            return result.sorted()
+        }
+        func describe(_ occs: [IndexStoreOccurrence]) -> [String] {
+            occs.map { "\($0.symbol.usr ?? ""):\($0.location.line):\($0.location.column)" }.sorted()
+        }
+
+        XCTAssertEqual(
+            try occurrences(matching: .init(roles: .definition)),
+            describe(all.filter { $0.roles.contains(.definition) })
+        )
+        XCTAssertEqual(
+            try occurrences(matching: .init(roles: [.definition, .reference], kinds: [.class])),
+            describe(all.filter { !$0.roles.isDisjoint(with: [.definition, .reference]) && $0.symbol.kind == .class })
+        )
+        let viewModelUSR = try XCTUnwrap(all.first { $0.symbol.name == "viewModel" }?.symbol.usr)
+        XCTAssertEqual(
+            try occurrences(matching: .init(usrPrefixes: [viewModelUSR])),
+            describe(all.filter { $0.symbol.usr?.hasPrefix(viewModelUSR) ?? false })
+        )
+        XCTAssertEqual(try occurrences(matching: .init(usrPrefixes: ["no-such-usr"])), [])
+
+        var symbols: [String] = []
+        try indexStore.forEachSymbols(for: record, matching: .init(kinds: [.class])) { symbol in
+            symbols.append(symbol.name ?? "")
+            return true
+        }
+        XCTAssertEqual(Set(symbols), ["ViewController", "ViewModel"])
+
+        var systemRecords = 0
+        try indexStore.forEachOccurrences(matching: .init(roles: .definition, includeSystem: false)) { record, _ in
+            if record.isSystem { systemRecords += 1 }
+            return true
+        }
+        XCTAssertEqual(systemRecords, 0)
+    }
+
+    func testScanChanges() throws {
+        let initial = try indexStore.scanChanges(since: nil)
+        XCTAssertEqual(Set(initial.added), Set(indexStore.units()))
+        XCTAssertTrue(initial.modified.isEmpty)
+        XCTAssertTrue(initial.removed.isEmpty)
+        XCTAssertFalse(initial.addedRecords.isEmpty)
+
+        let manifestURL = Self.space.directoryPath.appendingPathComponent("manifest.json")
+        try initial.manifest.write(to: manifestURL)
+        let loaded = try XCTUnwrap(IndexStoreManifest.load(from: manifestURL))
+        XCTAssertEqual(loaded, initial.manifest)
+
+        let unchanged = try indexStore.scanChanges(since: loaded)
+        XCTAssertTrue(unchanged.isEmpty)
+        XCTAssertEqual(unchanged.unchangedCount, initial.added.count)
+        XCTAssertTrue(unchanged.addedRecords.isEmpty)
+        XCTAssertTrue(unchanged.removedRecords.isEmpty)
+
+        var previous = loaded
+        let touched = try XCTUnwrap(previous.units.keys.first { $0.contains("ViewController") })
+        previous.units[touched]?.modificationTime = .init(seconds: 0, nanoseconds: 0)
+        previous.units["Deleted-unit"] = .init(
+            modificationTime: .init(seconds: 0, nanoseconds: 0), isSystem: false, records: ["Deleted-record"]
+        )
+        let changes = try indexStore.scanChanges(since: previous)
+        XCTAssertEqual(changes.modified, [IndexStoreUnit(name: touched)])
+        XCTAssertEqual(changes.removed, [IndexStoreUnit(name: "Deleted-unit")])
+        XCTAssertEqual(changes.removedRecords, ["Deleted-record"])
+        XCTAssertEqual(changes.manifest, initial.manifest)
+    }
+
+    func testScanChangesAfterRebuild() throws {
+        let space = try IndexSpace.create(with: .init())
+        try space.addSource(name: "Changing.swift", module: "ChangingModule", sourceCode: "struct Before {}")
+        try space.index()
+        let store = try IndexStore.open(store: space.indexStorePath, lib: indexStore.lib)
+        let initial = try store.scanChanges(since: nil)
+        let unit = try XCTUnwrap(initial.added.first { $0.name?.contains("Changing") ?? false })
+
+        // Rebuilding rewrites the unit under the same name.
+        Thread.sleep(forTimeInterval: 1)
+        try space.addSource(name: "Changing.swift", module: "ChangingModule", sourceCode: "struct After {}")
+        try space.index(sourceNamed: "Changing.swift")
+        let changes = try store.scanChanges(since: initial.manifest)
+        XCTAssertEqual(changes.modified, [unit])
+        XCTAssertFalse(changes.addedRecords.isEmpty)
+        XCTAssertFalse(changes.removedRecords.isEmpty)
+
+        let fresh = try IndexStore.open(store: space.indexStorePath, lib: indexStore.lib)
+        XCTAssertEqual(changes.manifest, try fresh.scanChanges(since: nil).manifest)
+        XCTAssertEqual(
+            try store.recordDependencies(for: unit).compactMap(\.record?.name),
+            try fresh.recordDependencies(for: unit).compactMap(\.record?.name)
+        )
+    }
+
+    func testUSRIndex() throws {
+        let indexURL = Self.space.directoryPath.appendingPathComponent("usr-index")
+        let index = try IndexStoreUSRIndex.build(from: indexStore, at: indexURL, includeSystem: false)
+        XCTAssertTrue(try index.isUpToDate(with: indexStore))
+
+        var expected: [String: [String]] = [:]
+        for entry in try indexStore.recordOwnership(includeSystem: false).records {
+            for occ in try indexStore.occurrences(for: entry.record) {
+                expected[occ.symbol.usr!, default: []].append(
+                    "\(entry.record.name!):\(occ.location.line):\(occ.location.column):\(occ.roles.rawValue)"
+                )
+            }
+        }
+        XCTAssertEqual(index.symbolCount, expected.count)
+        XCTAssertEqual(index.occurrenceCount, expected.values.reduce(0) { $0 + $1.count })
+        for (usr, occurrences) in expected {
+            let actual = index.occurrences(ofUSR: usr).map {
+                "\($0.record.name):\($0.line):\($0.column):\($0.roles.rawValue)"
+            }
+            XCTAssertEqual(actual.sorted(), occurrences.sorted(), usr)
+        }
+        XCTAssertTrue(index.occurrences(ofUSR: "no-such-usr").isEmpty)
+
+        let viewModelUSR = try XCTUnwrap(expected.keys.first { index.symbol(forUSR: $0)?.name == "ViewModel" })
+        let definitions = index.definitions(ofUSR: viewModelUSR)
+        XCTAssertEqual(definitions.count, 1)
+        XCTAssertTrue(definitions.first?.record.path?.hasSuffix("ViewModel.swift") ?? false)
+        XCTAssertEqual(index.symbol(forUSR: viewModelUSR)?.kind, .class)
+
+        // Rebuilding from the previous index reuses every record and yields the same file.
+        let original = try Data(contentsOf: indexURL)
+        try IndexStoreUSRIndex.build(from: indexStore, at: indexURL, previous: index, includeSystem: false)
+        XCTAssertEqual(try Data(contentsOf: indexURL), original)
+
+        // A symbol kind this library doesn't know reads as a missing symbol,
+        // and rebuilding rescans the records referencing it.
+        let viewModelIndex = try XCTUnwrap((0..<index.symbolCount).first { index.symbol(at: $0)?.usr == viewModelUSR })
+        var corrupted = original
+        let symbolTableOffset = corrupted[48..<56].withUnsafeBytes { Int(UInt64(littleEndian: $0.loadUnaligned(as: UInt64.self))) }
+        let kindOffset = symbolTableOffset + viewModelIndex * USRIndexLayout.symbolEntrySize + 16
+        corrupted.replaceSubrange(kindOffset..<kindOffset + 4, with: [0xff, 0xff, 0xff, 0xff])
+        try corrupted.write(to: indexURL)
+        let corruptedIndex = try IndexStoreUSRIndex.open(at: indexURL)
+        XCTAssertNil(corruptedIndex.symbol(forUSR: viewModelUSR))
+        XCTAssertEqual(corruptedIndex.definitions(ofUSR: viewModelUSR).count, 1)
+        try IndexStoreUSRIndex.build(from: indexStore, at: indexURL, previous: corruptedIndex, includeSystem: false)
+        XCTAssertEqual(try Data(contentsOf: indexURL), original)
+
+        try Data("not an index".utf8).write(to: indexURL)
+        XCTAssertThrowsError(try IndexStoreUSRIndex.open(at: indexURL))
+    }
+
+    func testAsyncStreams() async throws {
+        var units: [IndexStoreUnit] = []
+        for try await unit in indexStore.unitStream(configuration: .init(batchSize: 1, bufferedBatches: 1)) {
+            units.append(unit)
+        }
+        XCTAssertEqual(units, indexStore.units())
+
+        let unit = try XCTUnwrap(units.first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        var occurrences: [String] = []
+        for try await occ in indexStore.occurrenceStream(for: record, configuration: .init(batchSize: 3)) {
+            occurrences.append("\(occ.symbol.usr ?? ""):\(occ.location.line):\(occ.location.column)")
+        }
+        XCTAssertEqual(
+            occurrences,
+            try indexStore.occurrences(for: record).map { "\($0.symbol.usr ?? ""):\($0.location.line):\($0.location.column)" }
+        )
+
+        func describe(_ relations: [IndexStoreRelation]) -> [String] {
+            relations.map { "\($0.symbol.usr ?? ""):\($0.roles.rawValue)" }
+        }
+        var streamedRelations: [[String]] = []
+        for try await element in indexStore.occurrenceStreamWithRelations(for: record, configuration: .init(batchSize: 3)) {
+            streamedRelations.append(describe(element.relations))
+        }
+        var expectedRelations: [[String]] = []
+        try indexStore.forEachOccurrences(for: record) { occurrence in
+            expectedRelations.append(describe(indexStore.relations(for: occurrence)))
+            return true
+        }
+        XCTAssertEqual(streamedRelations, expectedRelations)
+        XCTAssertTrue(streamedRelations.contains { !$0.isEmpty })
+    }
+
+    func testAsyncStreamStopsProducerWhenConsumerStops() async throws {
+        let lock = UnfairLock()
+        var produced = 0
+        var isFinished = false
+        let stream = IndexStoreAsyncStream<Int>(configuration: .init(batchSize: 1, bufferedBatches: 1)) { yield in
+            defer { lock.perform { isFinished = true } }
+            for value in 0..<1000 {
+                lock.perform { produced += 1 }
+                guard yield(value) else { return }
+            }
+        }
+        for try await value in stream {
+            XCTAssertEqual(value, 0)
+            break
+        }
+        for _ in 0..<1000 where !lock.perform({ isFinished }) {
+            try await Task.sleep(nanoseconds: 10_000_000)
+        }
+        XCTAssertTrue(lock.perform { isFinished })
+        XCTAssertLessThan(lock.perform { produced }, 1000)
+    }
+
+    func testOccurrenceBatches() throws {
+        let tables = IndexStoreColumnarTables()
+        var batches: [IndexStoreOccurrenceBatch] = []
+        try indexStore.forEachOccurrenceBatches(matching: .init(includeSystem: false), tables: tables) { batch in
+            batches.append(batch)
+            return true
+        }
+        let records = try indexStore.recordOwnership(includeSystem: false).records.map(\.record)
+        XCTAssertEqual(Set(batches.map { tables.paths[Int($0.path)] }), Set(records.map(\.filePath)))
+
+        for batch in batches {
+            let path = tables.paths[Int(batch.path)]
+            let record = try XCTUnwrap(records.first { $0.filePath == path })
+            let expected = try indexStore.occurrences(for: record).map {
+                "\($0.symbol.usr ?? ""):\($0.symbol.kind):\($0.location.line):\($0.location.column):\($0.roles.rawValue)"
+            }
+            let actual = (0..<batch.count).map { index -> String in
+                let symbol = tables.symbols[Int(batch.symbols[index])]
+                let usr = tables.strings.string(for: symbol.usr)
+                return "\(usr):\(symbol.kind):\(batch.lines[index]):\(batch.columns[index]):\(batch.roles[index])"
+            }
+            XCTAssertEqual(actual, expected)
+        }
+        XCTAssertEqual(Set(tables.symbols.map(\.usr)).count, tables.symbols.count)
+    }
+
+    func testStringInterner() throws {
+        let interner = IndexStoreStringInterner(shardCount: 4)
+        let usrs = (0..<1000).map { "s:14TestModule\($0 % 100)" }
+        let ids = try indexStore.concurrentMap(usrs, workerCount: 8) { interner.intern($0) }
+        XCTAssertEqual(interner.count, 100)
+        XCTAssertEqual(Set(ids).count, 100)
+        for (usr, id) in zip(usrs, ids) {
+            XCTAssertEqual(interner.string(for: id), usr)
+            XCTAssertEqual(interner.id(for: usr), id)
+        }
+        XCTAssertNil(interner.id(for: "missing"))
+
+        let unit = indexStore.units().first(where: { $0.name?.contains("ViewController") ?? false })!
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        var interned: [IndexStoreInternedOccurrence] = []
+        try indexStore.forEachInternedOccurrences(for: record, interner: interner) { occ in
+            interned.append(occ)
+            return true
+        }
+        let occurrences = try indexStore.occurrences(for: record)
+        XCTAssertEqual(interned.count, occurrences.count)
+        for (internedOcc, occ) in zip(interned, occurrences) {
+            XCTAssertEqual(interner.string(for: internedOcc.symbol.usr), occ.symbol.usr ?? "")
+            XCTAssertEqual(interner.string(for: internedOcc.symbol.name), occ.symbol.name ?? "")
+            XCTAssertEqual(interner.string(for: internedOcc.path), record.filePath ?? "")
+            XCTAssertEqual(Int64(internedOcc.line), occ.location.line)
+        }
+    }
+
+    func testLineRangeOccurrences() throws {
+        let unit = indexStore.units().first(where: { $0.name?.contains("ViewController") ?? false })!
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        func describe(_ occs: [IndexStoreOccurrence]) -> [String] {
+            occs.map { "\($0.symbol.usr ?? ""):\($0.location.line):\($0.location.column)" }.sorted()
+        }
+        XCTAssertEqual(
+            describe(try indexStore.occurrences(for: record, lines: 2...3)),
+            describe(try indexStore.occurrences(for: record).filter { (2...3).contains($0.location.line) })
+        )
+
+        let path = try XCTUnwrap(record.filePath)
+        XCTAssertEqual(try indexStore.records(forPath: path).map(\.name), [record.name])
+        let atName = try indexStore.occurrences(atPath: path, line: 4, column: 23)
+        XCTAssertEqual(Set(atName.compactMap(\.symbol.name)), ["name", "getter:name"])
+        XCTAssertTrue(atName.allSatisfy { $0.location.column == 21 })
+        XCTAssertEqual(Set(try indexStore.occurrences(atPath: path, line: 4, column: 24).compactMap(\.symbol.name)), ["name", "getter:name"])
+        // Past the end of `name`, on the closing parenthesis and in trailing whitespace.
+        XCTAssertTrue(try indexStore.occurrences(atPath: path, line: 4, column: 25).isEmpty)
+        XCTAssertTrue(try indexStore.occurrences(atPath: path, line: 4, column: 40).isEmpty)
+        XCTAssertTrue(try indexStore.occurrences(atPath: path, line: 4, column: 4).isEmpty)
+        XCTAssertTrue(try indexStore.occurrences(atPath: "/no/such/file.swift", line: 1, column: 1).isEmpty)
+    }
+
+    func testSpelledLength() {
+        func length(_ name: String?, _ roles: IndexStoreOccurrence.Role = .reference) -> Int64 {
+            IndexStore.spelledLength(of: name, roles: roles)
+        }
+        XCTAssertEqual(length(nil), 0)
+        XCTAssertEqual(length("name"), 4)
+        XCTAssertEqual(length("getter:name"), 4)
+        XCTAssertEqual(length("load(_:options:)"), 4)
+        XCTAssertEqual(length("setObject:forKey:"), 9)
+        XCTAssertEqual(length("==(_:_:)"), 2)
+        XCTAssertEqual(length("..<(_:_:)"), 3)
+        XCTAssertEqual(length("init(name:)"), 4)
+        XCTAssertEqual(length("subscript(_:)", .definition), 9)
+        XCTAssertEqual(length("subscript(_:)"), 1)
+        XCTAssertEqual(length("getter:subscript(_:)"), 1)
+        XCTAssertEqual(length("default"), 9)
+        XCTAssertEqual(length("default(for:)"), 9)
+        XCTAssertEqual(length("é"), 2)
+    }
+
+    func testUnitGraph() throws {
+        let graph = try indexStore.unitGraph()
+        XCTAssertEqual(graph.units, indexStore.units())
+
+        let unit = try XCTUnwrap(graph.units.first { $0.name?.contains("ViewModel") ?? false })
+        let path = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record?.filePath }
+            .first { $0.hasSuffix("ViewModel.swift") })
+        XCTAssertTrue(graph.units(dependingOnFile: path).contains(unit))
+        XCTAssertTrue(graph.affectedUnits(changedFiles: ["/no/such/file.swift"]).isEmpty)
+
+        // a imports b, b imports c, c is built from c.swift.
+        let units = ["a", "b", "c", "d"].map { IndexStoreUnit(name: $0) }
+        let synthetic = IndexStoreUnitGraph(
+            units: units,
+            unitEdges: [(0, 1), (1, 2)],
+            files: ["c.swift", "d.swift"],
+            fileEdges: [(2, 0), (3, 1)],
+            records: ["c-record"],
+            recordEdges: [(2, 0)]
+        )
+        XCTAssertEqual(synthetic.affectedUnits(changedFiles: ["c.swift"]), Array(units[0...2]))
+        XCTAssertEqual(synthetic.affectedUnits(changedFiles: ["c.swift", "d.swift"]), units)
+        XCTAssertEqual(synthetic.units(dependingOnRecord: "c-record"), Array(units[0...2]))
+        XCTAssertEqual(synthetic.dependencies(of: units[0]), [units[1], units[2]])
+        XCTAssertEqual(synthetic.dependencies(of: units[0], transitive: false), [units[1]])
+        XCTAssertEqual(synthetic.dependents(of: units[2]), [units[0], units[1]])
+        // Cached closures give the same answers.
+        XCTAssertEqual(synthetic.dependents(of: units[2]), [units[0], units[1]])
+    }
+
+    func testUnusedDeclarations() throws {
+        // Nothing references ViewController; its members are folded into it.
+        let unused = try indexStore.unusedDeclarations()
+        XCTAssertEqual(unused.map(\.name), ["ViewController"])
+        XCTAssertEqual(unused.first?.kind, .class)
+        XCTAssertEqual(unused.first?.line, 1)
+
+        // viewModel is only read by the unused load() and getName().
+        let members = try indexStore.unusedDeclarations(options: .init(ignoredKinds: [.class, .extension]))
+        XCTAssertEqual(members.map(\.name), ["viewModel", "load()", "getName()"])
+    }
+
+    func testUnusedMutuallyReferencingMembers() throws {
+        let space = try IndexSpace.create(with: .init())
+        try space.addSource(name: "Cycle.swift", module: "CycleModule", sourceCode: """
+        struct Cycle {
+            func run() -> Int { helper() }
+            private func helper() -> Int { 1 }
+            private func ping(_ n: Int) -> Int { n > 0 ? pong(n - 1) : 0 }
+            private func pong(_ n: Int) -> Int { n > 0 ? ping(n - 1) : 0 }
+        }
+        func entry() -> Int { Cycle().run() }
+        """)
+        try space.index()
+        let store = try IndexStore.open(store: space.indexStorePath, lib: indexStore.lib)
+        // helper() is reached from run(), which entry() calls; ping and pong
+        // only call each other.
+        XCTAssertEqual(try store.unusedDeclarations().map(\.name), ["ping(_:)", "pong(_:)", "entry()"])
+    }
+
+    func testInstrumentation() throws {
+        let store = try IndexStore.open(store: Self.space.indexStorePath, lib: indexStore.lib)
+        XCTAssertNil(IndexStoreInstrumentation.snapshot())
+
+        IndexStoreInstrumentation.start()
+        var occurrences = 0
+        for unit in store.units(includeSystem: false) {
+            for case .record(let record) in try store.recordDependencies(for: unit) {
+                try store.forEachOccurrences(for: record) { occurrence in
+                    _ = occurrence.symbol.usr
+                    occurrences += 1
+                    return true
+                }
+            }
+        }
+        let snapshot = try XCTUnwrap(IndexStoreInstrumentation.stop(store: store))
+        XCTAssertFalse(IndexStoreInstrumentation.isEnabled)
+
+        XCTAssertGreaterThan(occurrences, 0)
+        XCTAssertEqual(snapshot.scans[.occurrences]?.elements, occurrences)
+        XCTAssertEqual(snapshot.scans[.units]?.count, 1)
+        XCTAssertGreaterThan(snapshot.calls["record_reader_occurrences_apply_f"] ?? 0, 0)
+        XCTAssertGreaterThan(snapshot.calls["occurrence_get_symbol"] ?? 0, 0)
+        XCTAssertEqual(snapshot.constructedValues, occurrences)
+        XCTAssertGreaterThan(snapshot.unitReadersCreated, 0)
+        XCTAssertGreaterThan(snapshot.recordReadersCreated, 0)
+        XCTAssertGreaterThan(snapshot.materializedStringBytes, 0)
+        XCTAssertEqual(snapshot.unitReaderCache, store.unitReaderCacheStatistics)
+    }
+
+    func testLibraryLoading() throws {
+        try XCTSkipIf(ProcessInfo.processInfo.environment[LibIndexStore.libraryPathEnvironmentVariable] != nil)
+        let directory = FileManager.default.temporaryDirectory.appendingPathComponent("LibraryLoading-\(UUID())")
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+        defer { try? FileManager.default.removeItem(at: directory) }
+
+        // The toolchain lookup is written to the cache, and a cached path is
+        // used as long as it exists.
+        let cacheFile = directory.appendingPathComponent("libIndexStore-path")
+        let url = try LibIndexStore.libraryURL(cacheFile: cacheFile)
+        let cached = try String(contentsOf: cacheFile, encoding: .utf8)
+        XCTAssertTrue(cached.hasSuffix("\n" + url.path))
+        let key = cached[..<cached.lastIndex(of: "\n")!]
+        let other = directory.appendingPathComponent("libOther.so")
+        try Data().write(to: other)
+        try Data((key + "\n" + other.path).utf8).write(to: cacheFile)
+        XCTAssertEqual(try LibIndexStore.libraryURL(cacheFile: cacheFile).path, other.path)
+        try Data((key + "\n" + directory.appendingPathComponent("missing").path).utf8).write(to: cacheFile)
+        XCTAssertEqual(try LibIndexStore.libraryURL(cacheFile: cacheFile), url)
+
+        XCTAssertThrowsError(try LibIndexStore.open(url: other)) { error in
+            XCTAssertTrue(error.localizedDescription.contains(other.path))
+        }
+
+        // Optional entry points are bound on first use.
+        let lib = try LibIndexStore.open(url: url)
+        XCTAssertFalse(lib.isBound(.lineRange))
+        let store = try IndexStore.open(store: Self.space.indexStorePath, lib: lib)
+        let record = try XCTUnwrap(store.units().flatMap { try store.recordDependencies(for: $0) }.compactMap(\.record).first)
+        _ = try store.occurrences(for: record, lines: 1...10)
+        XCTAssertTrue(lib.isBound(.lineRange))
+        XCTAssertFalse(lib.isBound(.unitEvents))
+        XCTAssertTrue(try LibIndexStore.shared === LibIndexStore.shared)
+    }
+
+    func testFilteredScanOnFreshLibrary() throws {
+        // Symbol predicates use an entry point that is bound on first use.
+        let lib = try LibIndexStore.open(url: URL(fileURLWithPath: indexStore.lib.getPath()))
+        XCTAssertFalse(lib.isBound(.symbolSearch))
+        let store = try IndexStore.open(store: Self.space.indexStorePath, lib: lib)
+        let unit = try XCTUnwrap(store.units().first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(store.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let filtered = try store.occurrences(for: record).filter { $0.roles.contains(.definition) }
+        var found: [String] = []
+        try store.forEachOccurrences(for: record, matching: .init(roles: .definition)) { occ in
+            found.append("\(occ.symbol.usr ?? ""):\(occ.location.line):\(occ.location.column)")
+            return true
+        }
+        XCTAssertTrue(lib.isBound(.symbolSearch))
+        XCTAssertFalse(found.isEmpty)
+        XCTAssertEqual(found.sorted(), filtered.map { "\($0.symbol.usr ?? ""):\($0.location.line):\($0.location.column)" }.sorted())
+    }
+
+    func testQueryServer() throws {
+        let unit = try XCTUnwrap(indexStore.units().first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let path = try XCTUnwrap(record.filePath)
+        let usr = try XCTUnwrap(indexStore.symbols(for: record).first { $0.name == "ViewModel" }?.usr)
+
+        let engine = IndexStoreQueryEngine(store: indexStore)
+        let queries: [IndexStoreQuery] = [
+            .references(usr: usr),
+            .definitions(name: "ViewModel"),
+            .units(path: path),
+            .occurrences(path: path, lines: 2...2),
+            .references(usr: "no such usr"),
+        ]
+        let results = engine.run(queries)
+        guard case .occurrences(let references) = results[0],
+              case .occurrences(let definitions) = results[1],
+              case .occurrences(let occurrences) = results[3] else {
+            return XCTFail("unexpected results \(results)")
+        }
+        XCTAssertEqual(references.map { "\(URL(fileURLWithPath: $0.path ?? "").lastPathComponent):\($0.line)" }, ["ViewController.swift:2"])
+        XCTAssertEqual(definitions.map { "\(URL(fileURLWithPath: $0.path ?? "").lastPathComponent):\($0.line)" }, ["ViewModel.swift:1"])
+        XCTAssertEqual(definitions.first?.usr, usr)
+        XCTAssertEqual(results[2], .units([try XCTUnwrap(unit.name)]))
+        XCTAssertFalse(occurrences.isEmpty)
+        XCTAssertTrue(occurrences.allSatisfy { $0.line == 2 })
+        XCTAssertTrue(occurrences.contains { $0.usr == usr })
+        XCTAssertEqual(results[4], .occurrences([]))
+
+        // Socket paths are limited to about a hundred bytes.
+        let socketPath = "/tmp/swift-indexstore-\(getpid())-\(UUID().uuidString.prefix(8)).sock"
+        let server = try IndexStoreQueryServer(engine: engine, socketPath: socketPath)
+        Thread.detachNewThread { try? server.run() }
+        defer { server.stop() }
+        let client = try IndexStoreQueryClient(socketPath: socketPath)
+        XCTAssertEqual(try client.run(queries), results)
+        XCTAssertEqual(try client.run(.units(path: path)), results[2])
+
+        let message = IndexStoreQueryProtocol.encode(queries)
+        XCTAssertEqual(try IndexStoreQueryProtocol.decodeQueries(Array(message.dropFirst(4))), queries)
+        XCTAssertThrowsError(try IndexStoreQueryProtocol.decodeQueries(Array(message.dropFirst(4).dropLast())))
+    }
+
+    func testQueryEngineAfterEdit() throws {
+        let space = try IndexSpace.create(with: .init())
+        try space.addSource(name: "Target.swift", module: "EditModule", sourceCode: "struct Target {}")
+        try space.addSource(name: "User.swift", module: "EditModule", sourceCode: "func makeTarget() -> Target { Target() }")
+        try space.index()
+        let store = try IndexStore.open(store: space.indexStorePath, lib: indexStore.lib)
+        let engine = IndexStoreQueryEngine(store: store)
+        try engine.warm()
+
+        guard case .occurrences(let definitions) = engine.run(.definitions(name: "Target")),
+              let usr = definitions.first?.usr else {
+            return XCTFail("Target is not defined")
+        }
+        guard case .occurrences(let before) = engine.run(.references(usr: usr)) else {
+            return XCTFail("no references result")
+        }
+        XCTAssertTrue(before.contains { $0.path?.hasSuffix("User.swift") ?? false })
+
+        // Rebuilding rewrites the unit of User.swift under the same name.
+        try space.addSource(name: "User.swift", module: "EditModule", sourceCode: "func makeNothing() {}")
+        try space.index(sourceNamed: "User.swift")
+        let unit = try XCTUnwrap(store.units().first { $0.name?.contains("User") ?? false })
+        engine.invalidate(units: [unit])
+
+        guard case .occurrences(let after) = engine.run(.references(usr: usr)),
+              case .occurrences(let added) = engine.run(.definitions(name: "makeNothing()")) else {
+            return XCTFail("unexpected results")
+        }
+        XCTAssertFalse(after.contains { $0.path?.hasSuffix("User.swift") ?? false })
+        XCTAssertEqual(added.count, 1)
+    }
+
+    func testFederation() throws {
+        // A copy of the store holds the same units and records under the same names.
+        let copy = FileManager.default.temporaryDirectory
+            .appendingPathComponent("swift-indexstore-federation-\(UUID().uuidString)")
+        try FileManager.default.copyItem(at: Self.space.indexStorePath, to: copy)
+        defer { try? FileManager.default.removeItem(at: copy) }
+
+        let federation = try IndexStoreFederation.open(
+            stores: [Self.space.indexStorePath, copy, Self.space.indexStorePath],
+            lib: indexStore.lib
+        )
+        XCTAssertEqual(federation.stores.count, 2)
+        XCTAssertEqual(try federation.units().map(\.value), indexStore.units())
+        XCTAssertTrue(try federation.units().allSatisfy { $0.store === federation.stores[0] })
+
+        let ownership = try indexStore.recordOwnership(includeSystem: false)
+        let records = try federation.distinctRecords(includeSystem: false)
+        XCTAssertEqual(records.map(\.record.name), ownership.records.map(\.record.name))
+        XCTAssertEqual(records.map { $0.units.map(\.value) }, ownership.records.map(\.units))
+
+        let unit = try XCTUnwrap(indexStore.units().first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        XCTAssertEqual(try federation.records(forPath: try XCTUnwrap(record.filePath)).map(\.value.name), [record.name])
+
+        let usr = try XCTUnwrap(indexStore.symbols(for: record).first { $0.name == "ViewModel" }?.usr)
+        let references = try federation.references(ofUSR: usr, includeSystem: false)
+        XCTAssertEqual(references.map { "\(URL(fileURLWithPath: $0.value.location.path ?? "").lastPathComponent):\($0.value.location.line)" }, ["ViewController.swift:2"])
+        XCTAssertTrue(references.allSatisfy { $0.value.symbol.usr == usr })
+        let definitions = try federation.definitions(ofUSR: usr, includeSystem: false)
+        XCTAssertEqual(definitions.map { "\(URL(fileURLWithPath: $0.value.location.path ?? "").lastPathComponent):\($0.value.location.line)" }, ["ViewModel.swift:1"])
+        XCTAssertGreaterThanOrEqual(try federation.occurrences(ofUSR: usr, includeSystem: false).count, 2)
+    }
+
+    func testFederationOccurrenceStream() async throws {
+        let copy = FileManager.default.temporaryDirectory
+            .appendingPathComponent("swift-indexstore-federation-\(UUID().uuidString)")
+        try FileManager.default.copyItem(at: Self.space.indexStorePath, to: copy)
+        defer { try? FileManager.default.removeItem(at: copy) }
+        let federation = try IndexStoreFederation.open(stores: [Self.space.indexStorePath, copy], lib: indexStore.lib)
+
+        let unit = try XCTUnwrap(indexStore.units().first { $0.name?.contains("ViewController") ?? false })
+        let record = try XCTUnwrap(indexStore.recordDependencies(for: unit)
+            .compactMap { $0.record }
+            .first(where: { $0.filePath?.contains("ViewController.swift") ?? false })
+        )
+        let usr = try XCTUnwrap(indexStore.symbols(for: record).first { $0.name == "ViewModel" }?.usr)
+        func describe(_ occurrence: IndexStoreFederation.Member<IndexStoreOccurrence>) -> String {
+            let location = occurrence.value.location
+            return "\(location.path ?? ""):\(location.line):\(location.column):\(occurrence.value.roles.rawValue)"
+        }
+        var streamed: [String] = []
+        for try await occurrence in federation.occurrenceStream(ofUSR: usr, includeSystem: false, configuration: .init(batchSize: 1)) {
+            XCTAssertEqual(occurrence.value.symbol.usr, usr)
+            streamed.append(describe(occurrence))
+        }
+        XCTAssertEqual(streamed.sorted(), try federation.occurrences(ofUSR: usr, includeSystem: false).map(describe).sorted())
+        XCTAssertGreaterThanOrEqual(streamed.count, 2)
+    }
 }
@@ -0,0 +1,42 @@
+import XCTest
+@testable import SwiftIndexStore
+
+final class UnitEventTests: XCTestCase {
+
+    func testUnitEvents() throws {
+        let space = try IndexSpace.create(with: .init())
+        try space.addSource(name: "First.swift", module: "EventModule", sourceCode: "struct First {}")
+        try space.index()
+        let lib = try LibIndexStore.open()
+        let indexStore = try IndexStore.open(store: space.indexStorePath, lib: lib)
+
+        let lock = UnfairLock()
+        var notifications: [IndexStoreUnitEventNotification] = []
+        let initialSync = expectation(description: "Initial sync")
+        let added = expectation(description: "Second unit added")
+        added.assertForOverFulfill = false
+        indexStore.startUnitEventListening(pollingInterval: 0.1) { notification in
+            lock.perform { notifications.append(notification) }
+            if notification.isInitial {
+                initialSync.fulfill()
+            }
+            if notification.events.contains(where: { $0.kind == .added && ($0.unit.name?.contains("Second") ?? false) }) {
+                added.fulfill()
+            }
+        }
+        defer { indexStore.stopUnitEventListening() }
+
+        wait(for: [initialSync], timeout: 10)
+        let initial = try XCTUnwrap(lock.perform { notifications.first })
+        XCTAssertTrue(initial.isInitial)
+        XCTAssertTrue(initial.events.contains { $0.kind == .added && ($0.unit.name?.contains("First") ?? false) })
+
+        try space.addSource(name: "Second.swift", module: "EventModule", sourceCode: "struct Second {}")
+        try space.index(sourceNamed: "Second.swift")
+        wait(for: [added], timeout: 10)
+
+        let live = lock.perform { notifications.dropFirst() }
+        XCTAssertFalse(live.contains { $0.isInitial })
+        XCTAssertFalse(live.flatMap(\.events).contains { $0.kind == .removed })
+    }
+}